@@ -19,6 +19,7 @@
 #include <stb_image_resize.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/scheduler.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -230,6 +231,13 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["decimationPower"] = 0;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
+    defConfig["channelizer"] = true;
+    defConfig["workerPool"] = false;
+    defConfig["workerPoolThreads"] = 0;
+    defConfig["timeShift"]["enabled"] = false;
+    defConfig["timeShift"]["duration"] = 60;
+    defConfig["timeShift"]["exportDuration"] = 30;
+    defConfig["timeShift"]["path"] = "%ROOT%/recordings";
 
     defConfig["streams"]["Radio"]["muted"] = false;
     defConfig["streams"]["Radio"]["sink"] = "Audio";
@@ -328,6 +336,10 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Run the DSP blocks on a shared pool of threads instead of one thread each
+    dsp::scheduler::setThreadCount(core::configManager.conf["workerPoolThreads"]);
+    dsp::scheduler::setEnabled(core::configManager.conf["workerPool"]);
+
     core::configManager.release(true);
 
     if (serverMode) { return server::main(); }
@@ -376,6 +388,8 @@ int sdrpp_main(int argc, char* argv[]) {
 
     // On android, none of this shutdown should happen due to the way the UI works
 #ifndef __ANDROID__
+    gui::mainWindow.deinit();
+
     // Shut down all modules
     for (auto& [name, mod] : core::moduleManager.modules) {
         mod.end();
@@ -3,8 +3,12 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <string>
+#include <memory>
 #include "stream.h"
 #include "types.h"
+#include "profiler.h"
+#include "scheduler.h"
 
 namespace dsp {
     class generic_block {
@@ -12,6 +16,7 @@ namespace dsp {
         virtual void start() {}
         virtual void stop() {}
         virtual int run() { return -1; }
+        virtual void setName(const std::string& name) {}
     };
 
     class block : public generic_block {
@@ -19,9 +24,11 @@ namespace dsp {
         virtual void init() {}
 
         virtual ~block() {
-            if (!_block_init) { return; }
-            stop();
-            _block_init = false;
+            if (_block_init) {
+                stop();
+                _block_init = false;
+            }
+            if (stats) { profiler::registry().remove(stats); }
         }
 
         virtual void start() {
@@ -62,18 +69,66 @@ namespace dsp {
             }
         }
 
+        // Name under which the block shows up in the profiler, defaults to its type
+        virtual void setName(const std::string& name) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            if (_block_init) { tempStop(); }
+            _name = name;
+            if (stats) {
+                profiler::registry().remove(stats);
+                stats.reset();
+            }
+            if (_block_init) { tempStart(); }
+        }
+
+        // Not locked since the worker thread needs it while stop() holds the lock, the name only changes while stopped
+        std::string getName() {
+            return _name.empty() ? profiler::typeName(typeid(*this)) : _name;
+        }
+
         virtual int run() = 0;
 
     protected:
         void workerLoop() {
-            while (run() >= 0) {}
+            while (runOnce() >= 0) {}
+        }
+
+        inline int runOnce() {
+            return profiler::isEnabled() ? profiledRun() : run();
+        }
+
+        int profiledRun() {
+            // Registered on first use so that only blocks that actually ran while profiling show up
+            if (!stats) { stats = profiler::registry().add(getName()); }
+            profiler::BlockStats* s = stats.get();
+
+            // Time spent waiting on streams is accounted for by the streams themselves, the rest is processing
+            uint64_t waitBefore = s->readWaitNs + s->swapWaitNs;
+            profiler::current = s;
+            uint64_t start = profiler::now();
+            int ret = run();
+            uint64_t elapsed = profiler::now() - start;
+            profiler::current = NULL;
+            uint64_t waited = s->readWaitNs + s->swapWaitNs - waitBefore;
+
+            s->busyNs.fetch_add((elapsed > waited) ? (elapsed - waited) : 0, std::memory_order_relaxed);
+            s->runs.fetch_add(1, std::memory_order_relaxed);
+            return ret;
         }
 
         virtual void doStart() {
+            // Blocks without inputs generate data at their own pace and keep a thread of their own
+            if (scheduler::isEnabled() && !inputs.empty()) {
+                startPooled();
+                return;
+            }
             workerThread = std::thread(&block::workerLoop, this);
         }
 
         virtual void doStop() {
+            // Keep the pool from running the block again, a run already in progress is unblocked by the stops below
+            if (pooled) { task.deactivate(); }
+
             for (auto& in : inputs) {
                 in->stopReader();
             }
@@ -81,6 +136,8 @@ namespace dsp {
                 out->stopWriter();
             }
 
+            if (pooled) { stopPooled(); }
+
             // TODO: Make sure this isn't needed, I don't know why it stops
             if (workerThread.joinable()) {
                 workerThread.join();
@@ -94,6 +151,23 @@ namespace dsp {
             }
         }
     
+        void startPooled() {
+            pooled = true;
+            for (auto& in : inputs) { in->setReaderTask(&task); }
+            for (auto& out : outputs) { out->setWriterTask(&task); }
+            task.activate();
+
+            // Data might already be waiting
+            task.notify();
+        }
+
+        void stopPooled() {
+            task.waitIdle();
+            for (auto& in : inputs) { in->setReaderTask(NULL); }
+            for (auto& out : outputs) { out->setWriterTask(NULL); }
+            pooled = false;
+        }
+
         void acquire() {
             ctrlMtx.lock();
         }
@@ -129,5 +203,35 @@ namespace dsp {
         bool tempStopped = false;
         int tempStopDepth = 0;
         std::thread workerThread;
+
+        std::string _name;
+        std::shared_ptr<profiler::BlockStats> stats;
+
+    private:
+        // Runs the block from the worker pool when all of its inputs have data and all of its outputs can be swapped
+        class BlockTask : public scheduler::Task {
+        public:
+            BlockTask(block* b) : _block(b) {}
+
+            bool ready() {
+                for (auto& in : _block->inputs) {
+                    if (!in->readable()) { return false; }
+                }
+                for (auto& out : _block->outputs) {
+                    if (!out->writable()) { return false; }
+                }
+                return true;
+            }
+
+            bool execute() {
+                return _block->runOnce() >= 0;
+            }
+
+        private:
+            block* _block;
+        };
+
+        BlockTask task = BlockTask(this);
+        bool pooled = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include "../scheduler.h"
+
+namespace dsp::buffer {
+    // Counts the readers still holding a buffer that was handed out to several streams at once.
+    // Each hand out is a new round so that late releases from a previous round are ignored.
+    class RefCount {
+    public:
+        uint64_t begin() {
+            std::lock_guard<std::mutex> lck(mtx);
+            refs = 0;
+            return ++round;
+        }
+
+        void add() {
+            std::lock_guard<std::mutex> lck(mtx);
+            refs++;
+        }
+
+        void release(uint64_t id) {
+            // Notify under the lock so that the owner can free this object as soon as it sees it released
+            std::lock_guard<std::mutex> lck(mtx);
+            if (id != round || refs <= 0) { return; }
+            if (--refs) { return; }
+            cv.notify_all();
+        }
+
+        bool released() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return refs <= 0;
+        }
+
+        bool wait() {
+            std::unique_lock<std::mutex> lck(mtx);
+            if (refs > 0 && !stopped) {
+                scheduler::Blocking blocking;
+                cv.wait(lck, [this]() { return refs <= 0 || stopped; });
+            }
+            return !stopped;
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                stopped = true;
+            }
+            cv.notify_all();
+        }
+
+        void clearStop() {
+            stopped = false;
+        }
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        uint64_t round = 0;
+        int refs = 0;
+        bool stopped = false;
+    };
+}
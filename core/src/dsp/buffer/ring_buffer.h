@@ -1,5 +1,6 @@
 #pragma once
 #include "buffer.h"
+#include "../scheduler.h"
 
 #define RING_BUF_SZ 1000000
 
@@ -114,6 +115,7 @@ namespace dsp::buffer {
             if (_stopReader) { return -1; }
             int _r = getReadable();
             if (_r != 0) { return _r; }
+            scheduler::Blocking blocking;
             std::unique_lock<std::mutex> lck(_readable_mtx);
             canReadVar.wait(lck, [=]() { return ((this->getReadable(false) > 0) || this->getReadStop()); });
             if (_stopReader) { return -1; }
@@ -164,6 +166,7 @@ namespace dsp::buffer {
             if (_stopWriter) { return -1; }
             int _w = getWritable();
             if (_w != 0) { return _w; }
+            scheduler::Blocking blocking;
             std::unique_lock<std::mutex> lck(_writable_mtx);
             canWriteVar.wait(lck, [=]() { return ((this->getWritable(false) > 0) || this->getWriteStop()); });
             if (_stopWriter) { return -1; }
@@ -0,0 +1,440 @@
+#pragma once
+#include "../block.h"
+#include <volk/volk.h>
+#include <utils/mapped_file.h>
+#include <utils/wav.h>
+#include <utils/flog.h>
+#include <condition_variable>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+// Number of input buffers that can be queued between the input and the output while live
+#define TIME_SHIFT_JITTER_BUFFERS   32
+
+// Chunk size used to export a part of the recording
+#define TIME_SHIFT_EXPORT_CHUNK     65536
+
+namespace dsp::buffer {
+    // Input buffer of the front end that can also record the baseband to a circular memory-mapped file, as int16 IQ.
+    // While live, samples go through a small in-memory queue that absorbs the jitter of the source. Once paused or
+    // moved back in time, the output is read from the recording instead, at the pace of the input, while the
+    // recording keeps going.
+    class TimeShiftBuffer : public block {
+        using base_type = block;
+    public:
+        TimeShiftBuffer() {}
+
+        TimeShiftBuffer(stream<complex_t>* in) { init(in); }
+
+        ~TimeShiftBuffer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            file.close();
+        }
+
+        void init(stream<complex_t>* in) {
+            _in = in;
+            base_type::registerInput(_in);
+            base_type::registerOutput(&out);
+            base_type::_block_init = true;
+        }
+
+        void setInput(stream<complex_t>* in) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            base_type::unregisterInput(_in);
+            _in = in;
+            base_type::registerInput(_in);
+            base_type::tempStart();
+        }
+
+        // When disabled and live, the input is sent to the output directly from the input thread
+        void setBuffering(bool enabled) {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            bypass = !enabled;
+            jitterRead = jitterWrite;
+        }
+
+        // Changing the samplerate starts a new recording, the old samples can't be played back at the new rate
+        void setSampleRate(double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (samplerate == _samplerate) { return; }
+            base_type::tempStop();
+            _samplerate = samplerate;
+            if (file.isOpen()) { openRecording(); }
+            base_type::tempStart();
+        }
+
+        // Record the last `seconds` of baseband to the file at path. Returns false if the file couldn't be created.
+        bool setRecording(bool enabled, std::string path, double seconds) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _path = path;
+            _seconds = seconds;
+            bool ok = true;
+            if (enabled) {
+                ok = openRecording();
+            }
+            else {
+                std::lock_guard<std::mutex> lck2(bufMtx);
+                file.close();
+                ring = NULL;
+                capacity = 0;
+                resetPositions();
+            }
+            base_type::tempStart();
+            return ok;
+        }
+
+        bool isRecording() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            return ring != NULL;
+        }
+
+        // Freeze the output, the recording continues
+        void pause() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            if (!ring || paused) { return; }
+            if (live) {
+                live = false;
+                readPos = writePos;
+            }
+            paused = true;
+        }
+
+        // Continue the playback from where it was paused, now behind live by the pause duration
+        void resume() {
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                if (!paused) { return; }
+                paused = false;
+                clampReadPos();
+                delay = writePos - readPos;
+            }
+            cnd.notify_all();
+        }
+
+        bool isPaused() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            return paused;
+        }
+
+        // Play back from `seconds` behind the live input
+        void seek(double seconds) {
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                if (!ring) { return; }
+                // Keep a margin from the oldest sample, it's about to be overwritten
+                uint64_t margin = std::min<uint64_t>(recorded(), 2 * (uint64_t)lastCount);
+                uint64_t samples = std::clamp<double>(seconds * _samplerate, 0, recorded() - margin);
+                if (!samples && !paused) {
+                    goLiveLocked();
+                }
+                else {
+                    live = false;
+                    readPos = writePos - samples;
+                    delay = samples;
+                }
+            }
+            cnd.notify_all();
+        }
+
+        void goLive() {
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                goLiveLocked();
+            }
+            cnd.notify_all();
+        }
+
+        bool isLive() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            return live;
+        }
+
+        // Time behind the live input in seconds
+        double getDelay() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            if (live) { return 0.0; }
+            return (double)(writePos - readPos) / _samplerate;
+        }
+
+        // Duration of the recording available for playback in seconds
+        double getRecorded() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            return (double)recorded() / _samplerate;
+        }
+
+        // Write `duration` seconds of the recording starting `seconds` behind live to a WAV file
+        bool exportWindow(std::string path, double seconds, double duration) {
+            uint64_t start, end;
+            double samplerate;
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                if (!ring) { return false; }
+                samplerate = _samplerate;
+                uint64_t back = std::clamp<double>(seconds * samplerate, 0, recorded());
+                start = writePos - back;
+                end = start + std::clamp<double>(duration * samplerate, 0, back);
+            }
+            if (end <= start) { return false; }
+
+            // The writer switches the file to RF64 on close if it went over 4GB
+            wav::Writer writer(2, samplerate, wav::FORMAT_WAV, wav::SAMP_TYPE_INT16);
+            if (!writer.open(path)) {
+                flog::error("Could not open '{0}' to export the time shift buffer", path);
+                return false;
+            }
+
+            std::vector<complex_t> buf(TIME_SHIFT_EXPORT_CHUNK);
+            for (uint64_t pos = start; pos < end; pos += TIME_SHIFT_EXPORT_CHUNK) {
+                int count = std::min<uint64_t>(end - pos, TIME_SHIFT_EXPORT_CHUNK);
+                if (!readRing(pos, count, buf.data())) {
+                    flog::error("The time shift export was overwritten by the recording before it could finish");
+                    writer.close();
+                    return false;
+                }
+                writer.write((float*)buf.data(), count);
+            }
+            writer.close();
+            return true;
+        }
+
+        // Drop the samples waiting in the live queue
+        void flush() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            jitterRead = jitterWrite;
+        }
+
+        int run() {
+            // Wait for data
+            int count = _in->read();
+            if (count < 0) { return -1; }
+
+            // Append to the recording. The space is reserved first so that readers can tell if it got overwritten.
+            bool isLive;
+            bool isBypass;
+            uint64_t pos;
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                pos = writePos;
+                reservedEnd = writePos + (ring ? count : 0);
+                isLive = live;
+                isBypass = bypass;
+                lastCount = count;
+            }
+            if (ring) {
+                writeRing(pos, count, _in->readBuf);
+            }
+
+            // Send directly to the output when live and not buffering
+            if (isLive && isBypass) {
+                std::lock_guard<std::mutex> lck(outMtx);
+                memcpy(out.writeBuf, _in->readBuf, count * sizeof(complex_t));
+                if (!out.swap(count)) {
+                    _in->flush();
+                    return -1;
+                }
+            }
+
+            // Queue the buffer for the output thread
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                writePos = reservedEnd;
+                if (live && !bypass) {
+                    std::vector<complex_t>& jbuf = jitter[jitterWrite];
+                    if (jbuf.size() < count) { jbuf.resize(count); }
+                    memcpy(jbuf.data(), _in->readBuf, count * sizeof(complex_t));
+                    jitterSizes[jitterWrite] = count;
+                    jitterWrite = (jitterWrite + 1) % TIME_SHIFT_JITTER_BUFFERS;
+                }
+            }
+            cnd.notify_all();
+
+            _in->flush();
+            return count;
+        }
+
+        stream<complex_t> out;
+
+    private:
+        void worker() {
+            while (true) {
+                std::unique_lock<std::mutex> lck(bufMtx);
+                cnd.wait(lck, [this]() { return stopWorker || (live && jitterRead != jitterWrite) || (!live && !paused && playable() > 0); });
+                if (stopWorker) { break; }
+
+                if (live) {
+                    // Take the oldest queued buffer
+                    int count = jitterSizes[jitterRead];
+                    std::lock_guard<std::mutex> lck2(outMtx);
+                    memcpy(out.writeBuf, jitter[jitterRead].data(), count * sizeof(complex_t));
+                    jitterRead = (jitterRead + 1) % TIME_SHIFT_JITTER_BUFFERS;
+                    lck.unlock();
+                    if (!out.swap(count)) { break; }
+                    continue;
+                }
+
+                // Play back as many samples as were recorded since the last time so that the delay stays the same
+                uint64_t pos = readPos;
+                int count = std::min<uint64_t>(playable(), std::clamp<int>(lastCount, 1, STREAM_BUFFER_SIZE));
+                lck.unlock();
+
+                std::lock_guard<std::mutex> lck2(outMtx);
+                bool valid = readRing(pos, count, out.writeBuf);
+                lck.lock();
+                if (live || readPos != pos) { continue; }
+                if (!valid) {
+                    // Overwritten while reading, skip to the oldest sample still there
+                    clampReadPos();
+                    delay = writePos - readPos;
+                    continue;
+                }
+                readPos = pos + count;
+                lck.unlock();
+                if (!out.swap(count)) { break; }
+            }
+        }
+
+        void doStart() {
+            base_type::workerThread = std::thread(&TimeShiftBuffer::workerLoop, this);
+            readWorkerThread = std::thread(&TimeShiftBuffer::worker, this);
+        }
+
+        void doStop() {
+            _in->stopReader();
+            out.stopWriter();
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                stopWorker = true;
+            }
+            cnd.notify_all();
+
+            if (base_type::workerThread.joinable()) { base_type::workerThread.join(); }
+            if (readWorkerThread.joinable()) { readWorkerThread.join(); }
+
+            _in->clearReadStop();
+            out.clearWriteStop();
+            stopWorker = false;
+        }
+
+        // Must be called with the block stopped
+        bool openRecording() {
+            std::lock_guard<std::mutex> lck(bufMtx);
+            file.close();
+            ring = NULL;
+            capacity = 0;
+            resetPositions();
+
+            uint64_t samples = _seconds * _samplerate;
+            if (!file.create(_path, samples * 2 * sizeof(int16_t))) {
+                flog::error("Could not create the time shift file '{0}'", _path);
+                return false;
+            }
+            ring = (int16_t*)file.data();
+            capacity = samples;
+            return true;
+        }
+
+        void resetPositions() {
+            writePos = 0;
+            reservedEnd = 0;
+            readPos = 0;
+            delay = 0;
+            live = true;
+            paused = false;
+        }
+
+        void goLiveLocked() {
+            live = true;
+            paused = false;
+            jitterRead = jitterWrite;
+        }
+
+        // Number of samples that can be played back, must be called with bufMtx held
+        inline uint64_t recorded() {
+            return std::min<uint64_t>(writePos, capacity);
+        }
+
+        // Oldest sample that won't be overwritten by the write in progress, must be called with bufMtx held
+        inline uint64_t oldest() {
+            return (reservedEnd > capacity) ? (reservedEnd - capacity) : 0;
+        }
+
+        inline void clampReadPos() {
+            readPos = std::max<uint64_t>(readPos, oldest());
+        }
+
+        // Samples that can be output without the delay getting shorter, must be called with bufMtx held
+        inline uint64_t playable() {
+            if (writePos < delay || writePos - delay <= readPos) { return 0; }
+            return writePos - delay - readPos;
+        }
+
+        void writeRing(uint64_t pos, int count, const complex_t* data) {
+            // The position is taken modulo the capacity, split the write in two when it wraps around
+            while (count) {
+                uint64_t offset = pos % capacity;
+                int n = std::min<uint64_t>(count, capacity - offset);
+                volk_32f_s32f_convert_16i(&ring[offset * 2], (const float*)data, 32767.0f, n * 2);
+                pos += n;
+                data += n;
+                count -= n;
+            }
+        }
+
+        // Returns false if some of the samples were overwritten while reading them
+        bool readRing(uint64_t pos, int count, complex_t* data) {
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                if (!ring || pos < oldest()) { return false; }
+            }
+            uint64_t start = pos;
+            int left = count;
+            while (left) {
+                uint64_t offset = pos % capacity;
+                int n = std::min<uint64_t>(left, capacity - offset);
+                volk_16i_s32f_convert_32f((float*)data, &ring[offset * 2], 32767.0f, n * 2);
+                pos += n;
+                data += n;
+                left -= n;
+            }
+            std::lock_guard<std::mutex> lck(bufMtx);
+            return start >= oldest();
+        }
+
+        stream<complex_t>* _in;
+
+        std::thread readWorkerThread;
+        std::mutex bufMtx;
+        std::mutex outMtx;
+        std::condition_variable cnd;
+        bool stopWorker = false;
+
+        // Live queue
+        std::vector<complex_t> jitter[TIME_SHIFT_JITTER_BUFFERS];
+        int jitterSizes[TIME_SHIFT_JITTER_BUFFERS];
+        int jitterWrite = 0;
+        int jitterRead = 0;
+        bool bypass = false;
+
+        // Recording, positions count samples since the start of the recording
+        mapped::File file;
+        std::string _path;
+        double _seconds = 60.0;
+        double _samplerate = 1000000.0;
+        int16_t* ring = NULL;
+        uint64_t capacity = 0;
+        uint64_t writePos = 0;
+        uint64_t reservedEnd = 0;
+        uint64_t readPos = 0;
+        uint64_t delay = 0;
+        int lastCount = 0;
+        bool live = true;
+        bool paused = false;
+    };
+}
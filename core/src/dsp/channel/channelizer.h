@@ -0,0 +1,336 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include "../sink.h"
+#include "../taps/windowed_sinc.h"
+#include "../taps/estimate_tap_count.h"
+#include "../window/nuttall.h"
+#include "../math/hz_to_rads.h"
+#include <fftw3.h>
+
+#define CHANNELIZER_DEFAULT_FFT_SIZE    8192
+
+namespace dsp::channel {
+    // Overlap-save FFT filter bank. The input is transformed once per hop of half an FFT and every channel
+    // is extracted from the same spectrum by selecting the bins around its center, filtering them in the
+    // frequency domain and running a small inverse FFT, which decimates it at the same time.
+    // The cost of each additional channel is a few bins worth of work instead of a full rate mixer and filter.
+    class Channelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        class Channel {
+        public:
+            // Decimated output, its samplerate is given by getSamplerate()
+            stream<complex_t> out;
+
+            double getSamplerate() { return samplerate; }
+
+            friend Channelizer;
+
+        private:
+            double offset;
+            double bandwidth;
+            double minSamplerate;
+            double samplerate;
+
+            int decim;
+            int bins;
+            int respBins;
+            int centerBin;
+
+            // Filter frequency response over the bins it covers, scaled for the inverse FFT
+            complex_t* resp = NULL;
+            complex_t* gathered = NULL;
+
+            complex_t* ifftIn = NULL;
+            complex_t* ifftOut = NULL;
+            fftwf_plan ifftPlan = NULL;
+
+            // Translation of the residual offset that isn't a multiple of the bin width
+            lv_32fc_t phase;
+            lv_32fc_t phaseDelta;
+
+            // Phase correction of the bin shift between consecutive blocks
+            lv_32fc_t blockCorr;
+        };
+
+        Channelizer() {}
+
+        Channelizer(stream<complex_t>* in, double samplerate, int fftSize = CHANNELIZER_DEFAULT_FFT_SIZE) { init(in, samplerate, fftSize); }
+
+        ~Channelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (auto& ch : channels) {
+                freeChannel(ch);
+                delete ch;
+            }
+            fftwf_destroy_plan(fftPlan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        void init(stream<complex_t>* in, double samplerate, int fftSize = CHANNELIZER_DEFAULT_FFT_SIZE) {
+            assert(!(fftSize & (fftSize - 1)));
+            _samplerate = samplerate;
+            _fftSize = fftSize;
+            hop = _fftSize / 2;
+
+            // Allocate FFT buffers, the first half of the input is the overlap with the previous block
+            fftIn = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            buffer::clear(fftIn, _fftSize);
+            fftPlan = fftwf_plan_dft_1d(_fftSize, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut, FFTW_FORWARD, FFTW_ESTIMATE);
+            inCount = _fftSize - hop;
+
+            base_type::init(in);
+        }
+
+        void setInSamplerate(double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _samplerate = samplerate;
+            for (auto& ch : channels) {
+                configureChannel(ch);
+            }
+            base_type::tempStart();
+        }
+
+        // The samplerate of the channel is the input samplerate divided by a power of two, at least 2*max(bandwidth, minSamplerate)
+        Channel* addChannel(double offset, double bandwidth, double minSamplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+
+            Channel* ch = new Channel;
+            ch->offset = offset;
+            ch->bandwidth = bandwidth;
+            ch->minSamplerate = minSamplerate;
+            configureChannel(ch);
+
+            channels.push_back(ch);
+            outCounts.resize(channels.size());
+            base_type::registerOutput(&ch->out);
+
+            base_type::tempStart();
+            return ch;
+        }
+
+        void removeChannel(Channel* ch) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the channel belongs to this channelizer
+            auto it = std::find(channels.begin(), channels.end(), ch);
+            if (it == channels.end()) {
+                throw std::runtime_error("[Channelizer] Tried to remove a channel that doesn't exist");
+            }
+
+            base_type::tempStop();
+            channels.erase(it);
+            outCounts.resize(channels.size());
+            base_type::unregisterOutput(&ch->out);
+            freeChannel(ch);
+            delete ch;
+            base_type::tempStart();
+        }
+
+        void setChannelOffset(Channel* ch, double offset) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            std::lock_guard<std::mutex> lck2(chanMtx);
+            ch->offset = offset;
+            generateResponse(ch);
+        }
+
+        // Can change the samplerate of the channel, only this channel is reconfigured and the others keep running
+        void setChannelBandwidth(Channel* ch, double bandwidth, double minSamplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            ch->bandwidth = bandwidth;
+            ch->minSamplerate = minSamplerate;
+            configureChannel(ch);
+        }
+
+        int getChannelCount() {
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            return channels.size();
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            // A block gives at most hop samples per channel, the outputs are sent before they could overflow
+            const int maxBlocks = STREAM_BUFFER_SIZE / hop;
+            const complex_t* in = base_type::_in->readBuf;
+            int left = count;
+            do {
+                std::fill(outCounts.begin(), outCounts.end(), 0);
+
+                {
+                    std::lock_guard<std::mutex> lck(chanMtx);
+                    int blocks = 0;
+                    while (left && blocks < maxBlocks) {
+                        // Fill the new part of the FFT input
+                        int toCopy = std::min<int>(_fftSize - inCount, left);
+                        memcpy(&fftIn[inCount], in, toCopy * sizeof(complex_t));
+                        inCount += toCopy;
+                        in += toCopy;
+                        left -= toCopy;
+                        if (inCount < _fftSize) { break; }
+
+                        // Transform the block and extract every channel from it
+                        fftwf_execute(fftPlan);
+                        for (int i = 0; i < channels.size(); i++) {
+                            outCounts[i] += processChannel(channels[i], &channels[i]->out.writeBuf[outCounts[i]]);
+                        }
+                        blocks++;
+
+                        // Keep the second half as the overlap of the next block
+                        memcpy(fftIn, &fftIn[hop], (_fftSize - hop) * sizeof(complex_t));
+                        inCount = _fftSize - hop;
+                    }
+                }
+
+                // The input can be released as soon as all of it is in the FFT buffer
+                if (!left) { base_type::_in->flush(); }
+
+                for (int i = 0; i < channels.size(); i++) {
+                    if (!outCounts[i]) { continue; }
+                    if (!channels[i]->out.swap(outCounts[i])) { return -1; }
+                }
+            } while (left);
+
+            return count;
+        }
+
+    protected:
+        inline int processChannel(Channel* ch, complex_t* out) {
+            // Gather the bins covered by the filter around the center of the channel, positive frequencies first like the FFT output
+            int half = ch->respBins / 2;
+            for (int i = 0; i < ch->respBins; i++) {
+                int rel = (i < half) ? i : (i - ch->respBins);
+                ch->gathered[i] = fftOut[(ch->centerBin + rel) & (_fftSize - 1)];
+            }
+
+            // Filter, then fold the transition band over the channel bins, this is what decimating in the time domain would do
+            volk_32fc_x2_multiply_32fc((lv_32fc_t*)ch->gathered, (lv_32fc_t*)ch->gathered, (lv_32fc_t*)ch->resp, ch->respBins);
+            if (ch->respBins > ch->bins) {
+                volk_32f_x2_add_32f((float*)ch->ifftIn, (float*)ch->gathered, (float*)&ch->gathered[ch->bins], ch->bins * 2);
+            }
+            else {
+                memcpy(ch->ifftIn, ch->gathered, ch->bins * sizeof(complex_t));
+            }
+
+            // Go back to time domain at the decimated samplerate
+            fftwf_execute(ch->ifftPlan);
+
+            // Only the second half of the block is free of circular convolution artifacts
+            int outCount = hop / ch->decim;
+            volk_32fc_s32fc_x2_rotator_32fc((lv_32fc_t*)out, (lv_32fc_t*)&ch->ifftOut[ch->bins - outCount], ch->phaseDelta, &ch->phase, outCount);
+            ch->phase *= ch->blockCorr;
+
+            return outCount;
+        }
+
+        void configureChannel(Channel* ch) {
+            std::lock_guard<std::mutex> lck(chanMtx);
+            freeChannel(ch);
+
+            // Pick the highest decimation that still leaves a wide transition band for the anti-aliasing filter
+            double passband = std::max<double>(ch->bandwidth, ch->minSamplerate) / 2.0;
+            ch->decim = 1;
+            while (ch->decim < (_fftSize / 16) && (_samplerate / (double)(ch->decim * 2)) >= 4.0 * passband) {
+                ch->decim *= 2;
+            }
+            ch->samplerate = _samplerate / (double)ch->decim;
+            ch->bins = _fftSize / ch->decim;
+            ch->respBins = std::min<int>(ch->bins * 2, _fftSize);
+
+            // Allocate the inverse FFT
+            ch->resp = buffer::alloc<complex_t>(ch->respBins);
+            ch->gathered = buffer::alloc<complex_t>(ch->respBins);
+            ch->ifftIn = (complex_t*)fftwf_malloc(ch->bins * sizeof(complex_t));
+            ch->ifftOut = (complex_t*)fftwf_malloc(ch->bins * sizeof(complex_t));
+            ch->ifftPlan = fftwf_plan_dft_1d(ch->bins, (fftwf_complex*)ch->ifftIn, (fftwf_complex*)ch->ifftOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+
+            // The rotator only restarts when the channel samplerate changes, retuning keeps its phase continuous
+            ch->phase = lv_cmake(1.0f, 0.0f);
+            generateResponse(ch);
+        }
+
+        void generateResponse(Channel* ch) {
+            // Split the offset into a whole number of bins and a residual
+            double binWidth = _samplerate / (double)_fftSize;
+            int centerBin = round(ch->offset / binWidth);
+            double residual = ch->offset - (double)centerBin * binWidth;
+            ch->centerBin = centerBin & (_fftSize - 1);
+
+            // Design the anti-aliasing filter, it must fit in the overlap of the blocks
+            double passband = std::max<double>(ch->bandwidth, ch->minSamplerate) / 2.0;
+            double transWidth = std::max<double>(ch->samplerate - 2.0 * passband, binWidth);
+            int tapCount = std::clamp<int>(taps::estimateTapCount(transWidth, _samplerate), 1, hop + 1);
+            tap<float> ftaps = taps::windowedSinc<float>(tapCount, ch->samplerate / 2.0, _samplerate, window::nuttall);
+
+            // Shift the filter by the residual offset and get its frequency response
+            complex_t* tin = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            complex_t* tout = (complex_t*)fftwf_malloc(_fftSize * sizeof(complex_t));
+            fftwf_plan tplan = fftwf_plan_dft_1d(_fftSize, (fftwf_complex*)tin, (fftwf_complex*)tout, FFTW_FORWARD, FFTW_ESTIMATE);
+            buffer::clear(tin, _fftSize);
+            double resOmega = math::hzToRads(residual, _samplerate);
+            for (int i = 0; i < tapCount; i++) {
+                tin[i] = { (float)(ftaps.taps[i] * cos(resOmega * (double)i)), (float)(ftaps.taps[i] * sin(resOmega * (double)i)) };
+            }
+            fftwf_execute(tplan);
+
+            // Keep the bins covered by the filter, normalized for unity gain and to compensate for the unscaled FFTs
+            float tapSum = 0.0f;
+            for (int i = 0; i < tapCount; i++) { tapSum += ftaps.taps[i]; }
+            int half = ch->respBins / 2;
+            for (int i = 0; i < ch->respBins; i++) {
+                int rel = (i < half) ? i : (i - ch->respBins);
+                ch->resp[i] = tout[rel & (_fftSize - 1)] / (tapSum * (float)_fftSize);
+            }
+
+            fftwf_destroy_plan(tplan);
+            fftwf_free(tin);
+            fftwf_free(tout);
+            taps::free(ftaps);
+
+            // The residual is removed at the output samplerate, the bin shift needs a correction between blocks
+            double resOutOmega = -math::hzToRads(residual, ch->samplerate);
+            double blockOmega = -2.0 * DB_M_PI * (double)centerBin * (double)hop / (double)_fftSize;
+            ch->phaseDelta = lv_cmake(cos(resOutOmega), sin(resOutOmega));
+            ch->blockCorr = lv_cmake(cos(blockOmega), sin(blockOmega));
+        }
+
+        void freeChannel(Channel* ch) {
+            if (ch->ifftPlan) { fftwf_destroy_plan(ch->ifftPlan); }
+            if (ch->ifftIn) { fftwf_free(ch->ifftIn); }
+            if (ch->ifftOut) { fftwf_free(ch->ifftOut); }
+            if (ch->resp) { buffer::free(ch->resp); }
+            if (ch->gathered) { buffer::free(ch->gathered); }
+            ch->ifftPlan = NULL;
+            ch->ifftIn = NULL;
+            ch->ifftOut = NULL;
+            ch->resp = NULL;
+            ch->gathered = NULL;
+        }
+
+        double _samplerate;
+        int _fftSize;
+        int hop;
+        int inCount;
+
+        complex_t* fftIn;
+        complex_t* fftOut;
+        fftwf_plan fftPlan;
+
+        std::vector<Channel*> channels;
+        std::vector<int> outCounts;
+        std::mutex chanMtx;
+    };
+}
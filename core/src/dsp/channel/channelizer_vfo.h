@@ -0,0 +1,66 @@
+#pragma once
+#include "rx_vfo.h"
+#include "channelizer.h"
+
+namespace dsp::channel {
+    // RxVFO fed by a channel of a shared Channelizer instead of the full rate baseband.
+    // The channelizer does the translation and most of the decimation, the VFO only resamples the channel
+    // to the requested samplerate and applies the final filter, at the samplerate of the channel.
+    class ChannelizerVFO : public RxVFO {
+        using base_type = RxVFO;
+    public:
+        ChannelizerVFO() {}
+
+        ChannelizerVFO(Channelizer* channelizer, double outSamplerate, double bandwidth, double offset) { init(channelizer, outSamplerate, bandwidth, offset); }
+
+        ~ChannelizerVFO() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            _channelizer->removeChannel(channel);
+        }
+
+        void init(Channelizer* channelizer, double outSamplerate, double bandwidth, double offset) {
+            _channelizer = channelizer;
+            channel = _channelizer->addChannel(offset, bandwidth, outSamplerate);
+            base_type::init(&channel->out, channel->getSamplerate(), outSamplerate, bandwidth, 0.0);
+        }
+
+        // The input samplerate is the one of the channel, the channelizer must be updated before calling this
+        void setInSamplerate(double inSamplerate) {
+            assert(base_type::_block_init);
+            base_type::setInSamplerate(channel->getSamplerate());
+        }
+
+        void setOutSamplerate(double outSamplerate, double bandwidth) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _channelizer->setChannelBandwidth(channel, bandwidth, outSamplerate);
+            base_type::setInSamplerate(channel->getSamplerate());
+            base_type::setOutSamplerate(outSamplerate, bandwidth);
+            base_type::tempStart();
+        }
+
+        void setBandwidth(double bandwidth) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _channelizer->setChannelBandwidth(channel, bandwidth, _outSamplerate);
+            base_type::setInSamplerate(channel->getSamplerate());
+            base_type::setBandwidth(bandwidth);
+            base_type::tempStart();
+        }
+
+        // The channelizer does the translation, the offset of the base VFO stays at 0 so that its
+        // translator doesn't shift the channel a second time when the samplerate changes
+        void setOffset(double offset) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _channelizer->setChannelOffset(channel, offset);
+        }
+
+    protected:
+        Channelizer* _channelizer;
+        Channelizer::Channel* channel;
+    };
+}
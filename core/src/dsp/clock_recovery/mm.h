@@ -4,6 +4,7 @@
 #include "../taps/windowed_sinc.h"
 #include "../multirate/polyphase_bank.h"
 #include "../math/step.h"
+#include "../filter/fixed_fir.h"
 
 namespace dsp::clock_recovery {
     template<class T>
@@ -102,6 +103,33 @@ namespace dsp::clock_recovery {
             memcpy(bufStart, in, count * sizeof(T));
 
             // Process all samples
+            int outCount = (this->*kernel)(count, out);
+            offset -= count;
+
+            // Update delay buffer
+            memmove(buffer, &buffer[count], (_interpTapCount - 1) * sizeof(T));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        // N is the interpolator tap count when known at compile time, 0 otherwise
+        template <int N>
+        int recover(int count, T* out) {
             int outCount = 0;
             while (offset < count) {
                 float error;
@@ -109,10 +137,13 @@ namespace dsp::clock_recovery {
 
                 // Calculate new output value
                 int phase = std::clamp<int>(floorf(pcl.phase * (float)_interpPhaseCount), 0, _interpPhaseCount - 1);
-                if constexpr (std::is_same_v<T, float>) {
+                if constexpr (N != 0) {
+                    outVal = filter::fixedDot<N>(&buffer[offset], interpBank.phases[phase]);
+                }
+                else if constexpr (std::is_same_v<T, float>) {
                     volk_32f_x2_dot_prod_32f(&outVal, &buffer[offset], interpBank.phases[phase], _interpTapCount);
                 }
-                if constexpr (std::is_same_v<T, complex_t>) {
+                else if constexpr (std::is_same_v<T, complex_t>) {
                     volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&outVal, (lv_32fc_t*)&buffer[offset], interpBank.phases[phase], _interpTapCount);
                 }
                 out[outCount++] = outVal;
@@ -147,34 +178,15 @@ namespace dsp::clock_recovery {
                 offset += delta;
                 pcl.phase -= delta;
             }
-            offset -= count;
-
-            // Update delay buffer
-            memmove(buffer, &buffer[count], (_interpTapCount - 1) * sizeof(T));
-
             return outCount;
         }
 
-        int run() {
-            int count = base_type::_in->read();
-            if (count < 0) { return -1; }
-
-            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
-
-            // Swap if some data was generated
-            base_type::_in->flush();
-            if (outCount) {
-                if (!base_type::out.swap(outCount)) { return -1; }
-            }
-            return outCount;
-        }
-
-    protected:
         void generateInterpTaps() {
             double bw = 0.5 / (double)_interpPhaseCount;
             dsp::tap<float> lp = dsp::taps::windowedSinc<float>(_interpPhaseCount * _interpTapCount, dsp::math::hzToRads(bw, 1.0), dsp::window::nuttall, _interpPhaseCount);
             interpBank = dsp::multirate::buildPolyphaseBank<float>(_interpPhaseCount, lp);
             taps::free(lp);
+            kernel = filter::dispatchTapCount(_interpTapCount, [](auto n) { return &MM::recover<decltype(n)::value>; });
         }
 
         dsp::multirate::PolyphaseBank<float> interpBank;
@@ -195,5 +207,6 @@ namespace dsp::clock_recovery {
         int offset = 0;
         T* buffer;
         T* bufStart;
+        int (MM::*kernel)(int count, T* out);
     };
 }
\ No newline at end of file
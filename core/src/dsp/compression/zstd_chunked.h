@@ -0,0 +1,211 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <zstd.h>
+#include <zstd_errors.h>
+
+namespace dsp::compression {
+    // Runs the jobs of a batch on a fixed set of threads, the calling thread takes part and returns once all are done
+    class ChunkWorkers {
+    public:
+        ChunkWorkers(int threadCount) {
+            _threadCount = std::max<int>(threadCount, 1);
+            for (int i = 1; i < _threadCount; i++) {
+                threads.push_back(std::thread(&ChunkWorkers::worker, this, i));
+            }
+        }
+
+        ~ChunkWorkers() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                stopWorkers = true;
+            }
+            startCV.notify_all();
+            for (auto& t : threads) { t.join(); }
+        }
+
+        // Calls fn(job, worker) for every job, worker is the index of the thread in [0, getThreadCount())
+        void run(int jobs, const std::function<void(int, int)>& fn) {
+            std::unique_lock<std::mutex> lck(mtx);
+            _fn = &fn;
+            jobCount = jobs;
+            nextJob = 0;
+            pending = jobs;
+            generation++;
+            lck.unlock();
+            startCV.notify_all();
+
+            work(0);
+
+            lck.lock();
+            doneCV.wait(lck, [this]() { return pending == 0; });
+            _fn = NULL;
+        }
+
+        int getThreadCount() { return _threadCount; }
+
+    private:
+        void worker(int id) {
+            uint64_t seen = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    startCV.wait(lck, [&]() { return generation != seen || stopWorkers; });
+                    if (stopWorkers) { return; }
+                    seen = generation;
+                }
+                work(id);
+            }
+        }
+
+        void work(int id) {
+            while (true) {
+                int job;
+                const std::function<void(int, int)>* fn;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    if (nextJob >= jobCount) { return; }
+                    job = nextJob++;
+                    fn = _fn;
+                }
+                (*fn)(job, id);
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    if (--pending) { continue; }
+                }
+                doneCV.notify_all();
+            }
+        }
+
+        int _threadCount;
+        std::vector<std::thread> threads;
+
+        std::mutex mtx;
+        std::condition_variable startCV;
+        std::condition_variable doneCV;
+        const std::function<void(int, int)>* _fn = NULL;
+        uint64_t generation = 0;
+        int jobCount = 0;
+        int nextJob = 0;
+        int pending = 0;
+        bool stopWorkers = false;
+    };
+
+    // Compresses a buffer as a sequence of independent zstd frames, one per chunk, in parallel.
+    // The result is a valid zstd stream, a plain ZSTD_decompressDCtx() call can still decode it.
+    class ChunkedCompressor {
+    public:
+        ChunkedCompressor(int threadCount, int chunkSize) : workers(threadCount) {
+            _chunkSize = chunkSize;
+            for (int i = 0; i < workers.getThreadCount(); i++) { cctxs.push_back(ZSTD_createCCtx()); }
+        }
+
+        ~ChunkedCompressor() {
+            for (auto& cctx : cctxs) { ZSTD_freeCCtx(cctx); }
+        }
+
+        // Worst case size of the output for a given input size
+        size_t bound(size_t size) {
+            size_t chunks = std::max<size_t>((size + _chunkSize - 1) / _chunkSize, 1);
+            return chunks * ZSTD_compressBound(_chunkSize);
+        }
+
+        // Returns the compressed size or a zstd error code (check with ZSTD_isError)
+        size_t compress(uint8_t* dst, size_t dstCapacity, const uint8_t* src, size_t size, int level) {
+            int chunks = std::max<int>((size + _chunkSize - 1) / _chunkSize, 1);
+
+            // Small buffers aren't worth handing out to the other threads
+            if (chunks == 1) { return ZSTD_compressCCtx(cctxs[0], dst, dstCapacity, src, size, level); }
+
+            // Compress each chunk into its own slot of the scratch buffer
+            size_t slotSize = ZSTD_compressBound(_chunkSize);
+            if (scratch.size() < chunks * slotSize) { scratch.resize(chunks * slotSize); }
+            results.resize(chunks);
+            workers.run(chunks, [&](int job, int worker) {
+                size_t offset = (size_t)job * _chunkSize;
+                size_t len = std::min<size_t>(_chunkSize, size - offset);
+                results[job] = ZSTD_compressCCtx(cctxs[worker], &scratch[job * slotSize], slotSize, &src[offset], len, level);
+            });
+
+            // Pack the frames one after the other
+            size_t total = 0;
+            for (int i = 0; i < chunks; i++) {
+                if (ZSTD_isError(results[i])) { return results[i]; }
+                if (total + results[i] > dstCapacity) { return (size_t)-ZSTD_error_dstSize_tooSmall; }
+                memcpy(&dst[total], &scratch[i * slotSize], results[i]);
+                total += results[i];
+            }
+            return total;
+        }
+
+    private:
+        ChunkWorkers workers;
+        size_t _chunkSize;
+        std::vector<ZSTD_CCtx*> cctxs;
+        std::vector<uint8_t> scratch;
+        std::vector<size_t> results;
+    };
+
+    // Decompresses a sequence of zstd frames, in parallel when every frame records its decompressed size
+    class ChunkedDecompressor {
+    public:
+        ChunkedDecompressor(int threadCount) : workers(threadCount) {
+            for (int i = 0; i < workers.getThreadCount(); i++) { dctxs.push_back(ZSTD_createDCtx()); }
+        }
+
+        ~ChunkedDecompressor() {
+            for (auto& dctx : dctxs) { ZSTD_freeDCtx(dctx); }
+        }
+
+        // Returns the decompressed size or a zstd error code (check with ZSTD_isError)
+        size_t decompress(uint8_t* dst, size_t dstCapacity, const uint8_t* src, size_t size) {
+            // Locate the frames and where their output goes
+            frames.clear();
+            size_t inOffset = 0;
+            size_t outOffset = 0;
+            while (inOffset < size) {
+                size_t frameSize = ZSTD_findFrameCompressedSize(&src[inOffset], size - inOffset);
+                unsigned long long contentSize = ZSTD_getFrameContentSize(&src[inOffset], size - inOffset);
+                if (ZSTD_isError(frameSize) || contentSize == ZSTD_CONTENTSIZE_ERROR) { return (size_t)-ZSTD_error_corruption_detected; }
+
+                // Without the decompressed sizes, the frames can only be decoded one after the other
+                if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN) { return ZSTD_decompressDCtx(dctxs[0], dst, dstCapacity, src, size); }
+
+                if (outOffset + contentSize > dstCapacity) { return (size_t)-ZSTD_error_dstSize_tooSmall; }
+                frames.push_back({ inOffset, frameSize, outOffset, (size_t)contentSize, 0 });
+                inOffset += frameSize;
+                outOffset += contentSize;
+            }
+            if (frames.size() <= 1) { return ZSTD_decompressDCtx(dctxs[0], dst, dstCapacity, src, size); }
+
+            workers.run(frames.size(), [&](int job, int worker) {
+                Frame& f = frames[job];
+                f.result = ZSTD_decompressDCtx(dctxs[worker], &dst[f.outOffset], f.outSize, &src[f.inOffset], f.inSize);
+            });
+
+            for (auto& f : frames) {
+                if (ZSTD_isError(f.result)) { return f.result; }
+            }
+            return outOffset;
+        }
+
+    private:
+        struct Frame {
+            size_t inOffset;
+            size_t inSize;
+            size_t outOffset;
+            size_t outSize;
+            size_t result;
+        };
+
+        ChunkWorkers workers;
+        std::vector<ZSTD_DCtx*> dctxs;
+        std::vector<Frame> frames;
+    };
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint.h>
+#include <stdexcept>
+#include <volk/volk.h>
+#include "../types.h"
+
+namespace dsp::convert {
+    enum IQFormat {
+        // Offset binary, centered on 128 (RTL-SDR)
+        IQ_FORMAT_U8,
+        IQ_FORMAT_I8,
+        // Two 12 bit little endian samples packed in three bytes
+        IQ_FORMAT_I12_PACKED,
+        IQ_FORMAT_I16,
+        IQ_FORMAT_I32
+    };
+
+    // Converts interleaved integer IQ samples to complex_t, removing a DC offset and swapping I and Q if needed.
+    // Signed formats use volk when there is nothing to fuse. Otherwise 8 bit formats go through a lookup table that has
+    // the offset and scale baked in, and wider formats through a loop simple enough for the compiler to vectorize.
+    class IQConverter {
+    public:
+        IQConverter() {}
+
+        IQConverter(IQFormat format, bool swapIQ = false) { init(format, swapIQ); }
+
+        void init(IQFormat format, bool swapIQ = false) {
+            _format = format;
+            _swapIQ = swapIQ;
+            _offset = (format == IQ_FORMAT_U8) ? 128.0f : 0.0f;
+            switch (format) {
+            case IQ_FORMAT_U8:
+            case IQ_FORMAT_I8:
+                _scale = 128.0f;
+                break;
+            case IQ_FORMAT_I12_PACKED:
+                _scale = 2048.0f;
+                break;
+            case IQ_FORMAT_I16:
+                _scale = 32768.0f;
+                break;
+            case IQ_FORMAT_I32:
+                _scale = 2147483647.0f;
+                break;
+            default:
+                throw std::runtime_error("Unknown IQ format");
+            }
+            updateLUT();
+        }
+
+        // Value of a raw sample that maps to zero, defaults to the center of the format (eg. 127.4 for RTL-SDR dongles)
+        void setOffset(float offset) {
+            _offset = offset;
+            updateLUT();
+        }
+
+        void setSwapIQ(bool swapIQ) {
+            _swapIQ = swapIQ;
+        }
+
+        // Size in bytes of one IQ pair
+        static int sampleSize(IQFormat format) {
+            switch (format) {
+            case IQ_FORMAT_U8:
+            case IQ_FORMAT_I8:
+                return 2;
+            case IQ_FORMAT_I12_PACKED:
+                return 3;
+            case IQ_FORMAT_I16:
+                return 4;
+            case IQ_FORMAT_I32:
+                return 8;
+            default:
+                return 0;
+            }
+        }
+
+        // Converts count IQ pairs
+        inline int process(int count, const void* in, complex_t* out) {
+            switch (_format) {
+            case IQ_FORMAT_U8:
+                convert8(count, (const uint8_t*)in, out);
+                break;
+            case IQ_FORMAT_I8:
+                if (_offset == 0.0f && !_swapIQ) {
+                    volk_8i_s32f_convert_32f((float*)out, (const int8_t*)in, _scale, count * 2);
+                    break;
+                }
+                convert8(count, (const uint8_t*)in, out);
+                break;
+            case IQ_FORMAT_I12_PACKED:
+                convert12(count, (const uint8_t*)in, out);
+                break;
+            case IQ_FORMAT_I16:
+                if (_offset == 0.0f && !_swapIQ) {
+                    volk_16i_s32f_convert_32f((float*)out, (const int16_t*)in, _scale, count * 2);
+                    break;
+                }
+                convertWide(count, (const int16_t*)in, out);
+                break;
+            case IQ_FORMAT_I32:
+                if (_offset == 0.0f && !_swapIQ) {
+                    volk_32i_s32f_convert_32f((float*)out, (const int32_t*)in, _scale, count * 2);
+                    break;
+                }
+                convertWide(count, (const int32_t*)in, out);
+                break;
+            }
+            return count;
+        }
+
+    private:
+        void updateLUT() {
+            for (int i = 0; i < 256; i++) {
+                float val = (_format == IQ_FORMAT_U8) ? (float)i : (float)(int8_t)i;
+                lut[i] = (val - _offset) / _scale;
+            }
+        }
+
+        inline void convert8(int count, const uint8_t* in, complex_t* out) {
+            int ii = _swapIQ ? 1 : 0;
+            int qi = _swapIQ ? 0 : 1;
+            for (int i = 0; i < count; i++) {
+                out[i].re = lut[in[2 * i + ii]];
+                out[i].im = lut[in[2 * i + qi]];
+            }
+        }
+
+        inline void convert12(int count, const uint8_t* in, complex_t* out) {
+            float scale = 1.0f / _scale;
+            float offset = _offset;
+            for (int i = 0; i < count; i++) {
+                const uint8_t* s = &in[3 * i];
+                int16_t a = (int16_t)(((uint16_t)s[0] | ((uint16_t)(s[1] & 0x0F) << 8)) << 4) >> 4;
+                int16_t b = (int16_t)(((uint16_t)(s[1] >> 4) | ((uint16_t)s[2] << 4)) << 4) >> 4;
+                float fa = ((float)a - offset) * scale;
+                float fb = ((float)b - offset) * scale;
+                out[i].re = _swapIQ ? fb : fa;
+                out[i].im = _swapIQ ? fa : fb;
+            }
+        }
+
+        template <class T>
+        inline void convertWide(int count, const T* in, complex_t* out) {
+            float scale = 1.0f / _scale;
+            float offset = _offset;
+            if (_swapIQ) {
+                for (int i = 0; i < count; i++) {
+                    out[i].re = ((float)in[2 * i + 1] - offset) * scale;
+                    out[i].im = ((float)in[2 * i] - offset) * scale;
+                }
+                return;
+            }
+            float* fout = (float*)out;
+            for (int i = 0; i < count * 2; i++) {
+                fout[i] = ((float)in[i] - offset) * scale;
+            }
+        }
+
+        IQFormat _format = IQ_FORMAT_I16;
+        bool _swapIQ = false;
+        float _offset = 0.0f;
+        float _scale = 32768.0f;
+        float lut[256];
+    };
+}
@@ -13,6 +13,10 @@
 #include "../math/add.h"
 #include "../math/subtract.h"
 #include "../multirate/rational_resampler.h"
+#include "../channel/frequency_xlator.h"
+
+// Number of samples carried through the pilot PLL and stereo matrix at once, small enough to stay in L1
+#define BROADCAST_FM_TILE_SIZE  256
 
 namespace dsp::demod {
     class BroadcastFM : public Processor<complex_t, stereo_t> {
@@ -28,6 +32,8 @@ namespace dsp::demod {
             buffer::free(lmr);
             buffer::free(l);
             buffer::free(r);
+            buffer::free(mpxBuf);
+            buffer::free(pllTile);
             taps::free(pilotFirTaps);
             taps::free(audioFirTaps);
         }
@@ -49,15 +55,19 @@ namespace dsp::demod {
             audioFirTaps = taps::lowPass(15000.0, 4000.0, _samplerate);
             alFir.init(NULL, audioFirTaps);
             arFir.init(NULL, audioFirTaps);
+            audioFir.init(NULL, audioFirTaps);
             xlator.init(NULL, -57000.0, samplerate);
             rdsResamp.init(NULL, samplerate, 5000.0);
 
             lmr = buffer::alloc<float>(STREAM_BUFFER_SIZE);
             l = buffer::alloc<float>(STREAM_BUFFER_SIZE);
             r = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            pllTile = buffer::alloc<complex_t>(BROADCAST_FM_TILE_SIZE);
+            allocMPX();
 
             lprDelay.out.free();
             arFir.out.free();
+            audioFir.out.free();
             alFir.out.free();
             xlator.out.free();
             rdsResamp.out.free();
@@ -87,11 +97,14 @@ namespace dsp::demod {
             pilotPLL.setInitialFreq(math::hzToRads(19000.0, _samplerate));
             lprDelay.setDelay(((pilotFirTaps.size - 1) / 2) + 1);
             lmrDelay.setDelay(((pilotFirTaps.size - 1) / 2) + 1);
+            buffer::free(mpxBuf);
+            allocMPX();
 
             taps::free(audioFirTaps);
             audioFirTaps = taps::lowPass(15000.0, 4000.0, _samplerate);
             alFir.setTaps(audioFirTaps);
             arFir.setTaps(audioFirTaps);
+            audioFir.setTaps(audioFirTaps);
 
             xlator.setOffset(-57000.0, samplerate);
             rdsResamp.setInSamplerate(samplerate);
@@ -138,10 +151,51 @@ namespace dsp::demod {
             lmrDelay.reset();
             alFir.reset();
             arFir.reset();
+            audioFir.reset();
+            buffer::clear(mpxBuf, mpxDelay);
             base_type::tempStart();
         }
 
+        // Only the pilot and audio filters, which need long blocks for their FFT convolution, go through the whole buffer.
+        // The PLL and the stereo matrix run one tile at a time and the L+R and L-R delays are a single history kept
+        // in front of the demodulated signal, so that it is never copied.
         inline int process(int count, complex_t* in, stereo_t* out, int& rdsOutCount, complex_t* rdsout = NULL) {
+            // Demodulate after the delay history
+            float* mpx = &mpxBuf[mpxDelay];
+            demod.process(count, in, mpx);
+
+            if (!_stereo) {
+                if (_rdsOut) { processRDS(count, mpx, rdsOutCount, rdsout); }
+                if (_lowPass) { alFir.process(count, mpx, mpx); }
+                convert::LRToStereo::process(count, mpx, mpx, out);
+                return count;
+            }
+
+            // Filter out the pilot, RDS can then reuse the complex signal
+            rtoc.process(count, mpx, rtoc.out.writeBuf);
+            pilotFir.process(count, rtoc.out.writeBuf, pilotFir.out.writeBuf);
+            if (_rdsOut) {
+                xlator.process(count, rtoc.out.writeBuf, rtoc.out.writeBuf);
+                rdsOutCount = rdsResamp.process(count, rtoc.out.writeBuf, rdsout);
+            }
+
+            // Lock on the pilot and demodulate L-R with twice its phase, the delayed composite starts at the beginning of the buffer
+            for (int start = 0; start < count; start += BROADCAST_FM_TILE_SIZE) {
+                int n = std::min<int>(count - start, BROADCAST_FM_TILE_SIZE);
+                pilotPLL.process(n, &pilotFir.out.writeBuf[start], pllTile);
+                stereoMatrix(n, &mpxBuf[start], pllTile, &out[start]);
+            }
+            memmove(mpxBuf, &mpxBuf[count], mpxDelay * sizeof(float));
+
+            // Both channels are filtered together, already interleaved
+            if (_lowPass) { audioFir.process(count, out, out); }
+
+            return count;
+        }
+
+        // Previous implementation running every step over the whole buffer, kept to verify the fused one.
+        // It shares state with process() so an instance must only ever use one of them.
+        inline int processUnfused(int count, complex_t* in, stereo_t* out, int& rdsOutCount, complex_t* rdsout = NULL) {
             // Demodulate
             demod.process(count, in, demod.out.writeBuf);
             if (_stereo) {
@@ -232,6 +286,29 @@ namespace dsp::demod {
         stream<complex_t> rdsOut;
 
     protected:
+        void allocMPX() {
+            mpxDelay = ((pilotFirTaps.size - 1) / 2) + 1;
+            mpxBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE + mpxDelay);
+            buffer::clear(mpxBuf, mpxDelay);
+        }
+
+        inline void processRDS(int count, float* mpx, int& rdsOutCount, complex_t* rdsout) {
+            rtoc.process(count, mpx, rtoc.out.writeBuf);
+            xlator.process(count, rtoc.out.writeBuf, rtoc.out.writeBuf);
+            rdsOutCount = rdsResamp.process(count, rtoc.out.writeBuf, rdsout);
+        }
+
+        // The delayed composite is real, so mixing it twice with the conjugate of the pilot only needs the real part.
+        // The operations are the same as the complex multiplies of the unfused path.
+        static inline void stereoMatrix(int count, const float* mpx, const complex_t* pilot, stereo_t* out) {
+            for (int i = 0; i < count; i++) {
+                float pr = pilot[i].re;
+                float pi = -pilot[i].im;
+                float lmr = 2.0f * (((mpx[i] * pr) * pr) - ((mpx[i] * pi) * pi));
+                out[i] = { mpx[i] + lmr, mpx[i] - lmr };
+            }
+        }
+
         double _deviation;
         double _samplerate;
         bool _stereo;
@@ -249,11 +326,17 @@ namespace dsp::demod {
         tap<float> audioFirTaps;
         filter::FIR<float, float> arFir;
         filter::FIR<float, float> alFir;
+        filter::FIR<stereo_t, float> audioFir;
         multirate::RationalResampler<dsp::complex_t> rdsResamp;
 
         float* lmr;
         float* l;
         float* r;
-        
+
+        // Demodulated signal preceded by the history needed to delay it like the pilot filter
+        float* mpxBuf;
+        int mpxDelay;
+        complex_t* pllTile;
+
     };
 }
\ No newline at end of file
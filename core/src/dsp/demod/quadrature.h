@@ -4,10 +4,20 @@
 #include "../math/hz_to_rads.h"
 #include "../math/normalize_phase.h"
 
+// Number of samples conjugate-multiplied at once in fast mode
+#define QUADRATURE_CHUNK_SIZE   1024
+
 namespace dsp::demod {
     class Quadrature : public Processor<complex_t, float> {
         using base_type = Processor<complex_t, float>;
     public:
+        enum Accuracy {
+            // Difference of the scalar phases of consecutive samples, as exact as atan2f
+            ACCURACY_PRECISE,
+            // Phase of each sample multiplied by the conjugate of the previous one, with volk's vectorized atan2
+            ACCURACY_FAST
+        };
+
         Quadrature() {}
 
         Quadrature(stream<complex_t>* in, double deviation) { init(in, deviation); }
@@ -37,18 +47,41 @@ namespace dsp::demod {
         }
 
         inline int process(int count, complex_t* in, float* out) {
-            for (int i = 0; i < count; i++) {
-                float cphase = in[i].phase();
-                out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
-                phase = cphase;
+            if (count <= 0) { return count; }
+
+            if (_accuracy == ACCURACY_PRECISE) {
+                float phase = lastSample.phase();
+                for (int i = 0; i < count; i++) {
+                    float cphase = in[i].phase();
+                    out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
+                    phase = cphase;
+                }
+                lastSample = in[count - 1];
+                return count;
+            }
+
+            // The phase of x[n] * conj(x[n-1]) is the phase difference, no unwrapping or serial dependency needed
+            float deviation = 1.0f / _invDeviation;
+            for (int i = 0; i < count; i += QUADRATURE_CHUNK_SIZE) {
+                int n = std::min<int>(QUADRATURE_CHUNK_SIZE, count - i);
+                diff[0] = in[i] * lastSample.conj();
+                volk_32fc_x2_multiply_conjugate_32fc((lv_32fc_t*)&diff[1], (lv_32fc_t*)&in[i + 1], (lv_32fc_t*)&in[i], n - 1);
+                lastSample = in[i + n - 1];
+                volk_32fc_s32f_atan2_32f(&out[i], (lv_32fc_t*)diff, deviation, n);
             }
             return count;
         }
 
+        void setAccuracy(Accuracy accuracy) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _accuracy = accuracy;
+        }
+
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phase = 0.0f;
+            lastSample = { 1.0f, 0.0f };
         }
 
         int run() {
@@ -64,6 +97,8 @@ namespace dsp::demod {
 
     protected:
         float _invDeviation;
-        float phase = 0.0f;
+        Accuracy _accuracy = ACCURACY_FAST;
+        complex_t lastSample = { 1.0f, 0.0f };
+        complex_t diff[QUADRATURE_CHUNK_SIZE];
     };
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "overlap_save.h"
+#include "fixed_fir.h"
+
+// Number of taps per output sample above which the FFT convolution is used instead of the direct form
+#define FIR_FFT_TAP_THRESHOLD   128
 
 namespace dsp::filter {
     template <class D, class T>
@@ -24,6 +29,7 @@ namespace dsp::filter {
             buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
             bufStart = &buffer[_taps.size - 1];
             buffer::clear<D>(buffer, _taps.size - 1);
+            updateKernels();
 
             base_type::init(in);
         }
@@ -47,7 +53,8 @@ namespace dsp::filter {
                 memcpy(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
                 buffer::clear<D>(buffer, _taps.size - oldTC);
             }
-            
+            updateKernels();
+
             base_type::tempStart();
         }
 
@@ -64,15 +71,24 @@ namespace dsp::filter {
             memcpy(bufStart, in, count * sizeof(D));
             
             // Do convolution
-            for (int i = 0; i < count; i++) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+            if (fastConvEnabled) {
+                fastConv.process(count, buffer, out);
+            }
+            else if (fixedConvolve) {
+                int offset = 0;
+                fixedConvolve(count, buffer, out, _taps.taps, 1, offset);
+            }
+            else {
+                for (int i = 0; i < count; i++) {
+                    if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                        volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                        volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+                    }
                 }
             }
 
@@ -94,8 +110,29 @@ namespace dsp::filter {
         }
 
     protected:
+        void updateKernels() {
+            // Small filters use a kernel specialized on their tap count
+            fixedConvolve = getFixedConvolve<D, T>(_taps.size);
+
+            // Only worth it with enough taps per output, the decimation is set by DecimatingFIR
+            if constexpr (OverlapSave<D, T>::supported) {
+                fastConvEnabled = ((int)_taps.size / fastConvDecim) >= FIR_FFT_TAP_THRESHOLD;
+                if (fastConvEnabled) {
+                    fastConv.setTaps(_taps);
+                }
+                else {
+                    fastConv.free();
+                }
+            }
+        }
+
         tap<T> _taps;
         D* buffer;
         D* bufStart;
+
+        OverlapSave<D, T> fastConv;
+        bool fastConvEnabled = false;
+        int fastConvDecim = 1;
+        FixedConvolveFunc<D, T> fixedConvolve = NULL;
     };
 }
\ No newline at end of file
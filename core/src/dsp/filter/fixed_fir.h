@@ -0,0 +1,93 @@
+#pragma once
+#include <type_traits>
+#include "../types.h"
+
+// Largest tap count with a kernel specialized at compile time, anything above goes through volk
+#define FIXED_FIR_MAX_TAPS  16
+
+namespace dsp::filter {
+    template <class D, class T>
+    constexpr bool fixedFIRSupported = (std::is_same_v<D, float> && std::is_same_v<T, float>) ||
+                                       ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && (std::is_same_v<T, float> || std::is_same_v<T, complex_t>));
+
+    // Dot product of N samples with N taps. With N known at compile time the loop is fully unrolled and the taps
+    // can stay in registers across outputs, which for a handful of taps is much cheaper than a volk call.
+    template <int N, class D, class T>
+    inline D fixedDot(const D* in, const T* taps) {
+        if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+            float sum = 0.0f;
+            for (int i = 0; i < N; i++) { sum += in[i] * taps[i]; }
+            return sum;
+        }
+        if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+            const float* fin = (const float*)in;
+            float a = 0.0f;
+            float b = 0.0f;
+            for (int i = 0; i < N; i++) {
+                a += fin[2 * i] * taps[i];
+                b += fin[(2 * i) + 1] * taps[i];
+            }
+            return { a, b };
+        }
+        if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+            const float* fin = (const float*)in;
+            float re = 0.0f;
+            float im = 0.0f;
+            for (int i = 0; i < N; i++) {
+                re += (fin[2 * i] * taps[i].re) - (fin[(2 * i) + 1] * taps[i].im);
+                im += (fin[2 * i] * taps[i].im) + (fin[(2 * i) + 1] * taps[i].re);
+            }
+            return { re, im };
+        }
+    }
+
+    // Filters count inputs (plus the taps-1 samples of history before them) with outputs every decimation samples
+    // starting at offset. Returns the number of outputs and leaves offset at the next one, relative to this input.
+    template <int N, class D, class T>
+    inline int fixedConvolve(int count, const D* in, D* out, const T* taps, int decimation, int& offset) {
+        // Local copy so that the compiler knows the taps can't change while writing the outputs
+        T t[N];
+        for (int i = 0; i < N; i++) { t[i] = taps[i]; }
+
+        int outCount = 0;
+        if (decimation == 1) {
+            for (int i = offset; i < count; i++) { out[outCount++] = fixedDot<N>(&in[i], t); }
+            offset = count;
+            return outCount;
+        }
+        for (; offset < count; offset += decimation) {
+            out[outCount++] = fixedDot<N>(&in[offset], t);
+        }
+        return outCount;
+    }
+
+    template <class D, class T>
+    using FixedConvolveFunc = int (*)(int count, const D* in, D* out, const T* taps, int decimation, int& offset);
+
+    // Calls f with the tap count as an std::integral_constant when a specialized kernel exists for it,
+    // or with std::integral_constant<int, 0> when the generic code must be used instead.
+    template <int N = FIXED_FIR_MAX_TAPS, class F>
+    inline auto dispatchTapCount(int tapCount, F&& f) {
+        if constexpr (N < 2) {
+            return f(std::integral_constant<int, 0>());
+        }
+        else {
+            if (tapCount == N) { return f(std::integral_constant<int, N>()); }
+            return dispatchTapCount<N - 1>(tapCount, f);
+        }
+    }
+
+    // Specialized convolution for the tap count, NULL if there is none
+    template <class D, class T>
+    inline FixedConvolveFunc<D, T> getFixedConvolve(int tapCount) {
+        if constexpr (!fixedFIRSupported<D, T>) {
+            return NULL;
+        }
+        else {
+            return dispatchTapCount(tapCount, [](auto n) -> FixedConvolveFunc<D, T> {
+                if constexpr (decltype(n)::value == 0) { return NULL; }
+                else { return &fixedConvolve<decltype(n)::value, D, T>; }
+            });
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <mutex>
+#include <algorithm>
+#include <type_traits>
+#include "../types.h"
+#include "../buffer/buffer.h"
+#include "../taps/tap.h"
+#include <fftw3.h>
+
+namespace dsp::filter {
+    // Overlap-save FFT convolution with the same input layout as the direct form FIR: the input starts
+    // with the last taps-1 samples of the previous call, and out[i] is the dot product of in[i..i+taps) with the taps.
+    // Real data uses a real FFT, complex and stereo data use a complex FFT (stereo only works with real taps).
+    template <class D, class T>
+    class OverlapSave {
+    public:
+        static constexpr bool supported = (std::is_same_v<D, float> && std::is_same_v<T, float>) ||
+                                          ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && (std::is_same_v<T, float> || std::is_same_v<T, complex_t>));
+
+        OverlapSave() {}
+
+        ~OverlapSave() { free(); }
+
+        void setTaps(tap<T>& taps) {
+            static_assert(supported);
+            free();
+            tapCount = taps.size;
+
+            // The FFT is at least four times the filter so that most of each block is usable output
+            fftSize = 256;
+            while (fftSize < 4 * tapCount) { fftSize *= 2; }
+            blockSize = fftSize - (tapCount - 1);
+            bins = std::is_same_v<D, float> ? (fftSize / 2) + 1 : fftSize;
+
+            // The direct form is a correlation, convolve with the time reversed taps instead
+            std::lock_guard<std::mutex> lck(planMtx());
+            resp = (complex_t*)fftwf_malloc(bins * sizeof(complex_t));
+            spectrum = (complex_t*)fftwf_malloc(bins * sizeof(complex_t));
+            if constexpr (std::is_same_v<D, float>) {
+                fftIn = (D*)fftwf_malloc(fftSize * sizeof(float));
+                ifftOut = (D*)fftwf_malloc(fftSize * sizeof(float));
+                buffer::clear(fftIn, fftSize);
+                for (int i = 0; i < tapCount; i++) { fftIn[i] = taps.taps[tapCount - 1 - i]; }
+                fftPlan = fftwf_plan_dft_r2c_1d(fftSize, fftIn, (fftwf_complex*)spectrum, FFTW_ESTIMATE);
+                ifftPlan = fftwf_plan_dft_c2r_1d(fftSize, (fftwf_complex*)spectrum, ifftOut, FFTW_ESTIMATE);
+            }
+            else {
+                fftIn = (D*)fftwf_malloc(fftSize * sizeof(complex_t));
+                ifftOut = (D*)fftwf_malloc(fftSize * sizeof(complex_t));
+                complex_t* cin = (complex_t*)fftIn;
+                buffer::clear(cin, fftSize);
+                for (int i = 0; i < tapCount; i++) {
+                    if constexpr (std::is_same_v<T, float>) {
+                        cin[i] = { taps.taps[tapCount - 1 - i], 0.0f };
+                    }
+                    else {
+                        cin[i] = taps.taps[tapCount - 1 - i];
+                    }
+                }
+                fftPlan = fftwf_plan_dft_1d(fftSize, (fftwf_complex*)fftIn, (fftwf_complex*)spectrum, FFTW_FORWARD, FFTW_ESTIMATE);
+                ifftPlan = fftwf_plan_dft_1d(fftSize, (fftwf_complex*)spectrum, (fftwf_complex*)ifftOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            }
+
+            // Frequency response of the filter, scaled to compensate for the unscaled FFTs
+            fftwf_execute(fftPlan);
+            volk_32f_s32f_multiply_32f((float*)resp, (float*)spectrum, 1.0f / (float)fftSize, bins * 2);
+        }
+
+        void free() {
+            std::lock_guard<std::mutex> lck(planMtx());
+            if (fftPlan) { fftwf_destroy_plan(fftPlan); }
+            if (ifftPlan) { fftwf_destroy_plan(ifftPlan); }
+            if (fftIn) { fftwf_free(fftIn); }
+            if (ifftOut) { fftwf_free(ifftOut); }
+            if (resp) { fftwf_free(resp); }
+            if (spectrum) { fftwf_free(spectrum); }
+            fftPlan = NULL;
+            ifftPlan = NULL;
+            fftIn = NULL;
+            ifftOut = NULL;
+            resp = NULL;
+            spectrum = NULL;
+        }
+
+        // Computes the outputs at offset, offset + decimation, ... up to count and returns how many were written.
+        // offset is left at the index of the next output, relative to the start of this input.
+        inline int process(int count, const D* in, D* out, int decimation, int& offset) {
+            int outCount = 0;
+            for (int i = 0; i < count; i += blockSize) {
+                int n = std::min<int>(blockSize, count - i);
+
+                // Skip blocks without any output, only happens for decimations higher than the block size
+                if (offset >= i + n) { continue; }
+
+                // Filter the block, only the samples after the first taps-1 are free of circular convolution artifacts
+                int avail = tapCount - 1 + n;
+                memcpy(fftIn, &in[i], avail * sizeof(D));
+                if (avail < fftSize) { buffer::clear(fftIn, fftSize - avail, avail); }
+                fftwf_execute(fftPlan);
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)spectrum, (lv_32fc_t*)spectrum, (lv_32fc_t*)resp, bins);
+                fftwf_execute(ifftPlan);
+
+                // Keep the needed outputs, the output at index j of the input is at index taps-1+j-i of the block
+                const D* valid = &ifftOut[tapCount - 1];
+                if (decimation == 1) {
+                    memcpy(&out[outCount], &valid[offset - i], (i + n - offset) * sizeof(D));
+                    outCount += i + n - offset;
+                    offset = i + n;
+                    continue;
+                }
+                for (; offset < i + n; offset += decimation) {
+                    out[outCount++] = valid[offset - i];
+                }
+            }
+            return outCount;
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            int offset = 0;
+            return process(count, in, out, 1, offset);
+        }
+
+    private:
+        // The FFTW planner isn't thread safe
+        static std::mutex& planMtx() {
+            static std::mutex mtx;
+            return mtx;
+        }
+
+        int tapCount = 0;
+        int fftSize = 0;
+        int blockSize = 0;
+        int bins = 0;
+
+        D* fftIn = NULL;
+        D* ifftOut = NULL;
+        complex_t* spectrum = NULL;
+        complex_t* resp = NULL;
+        fftwf_plan fftPlan = NULL;
+        fftwf_plan ifftPlan = NULL;
+    };
+}
@@ -50,6 +50,14 @@ namespace dsp {
             }
         }
 
+        // Name the sub-blocks after this block so they can be told apart in the profiler
+        virtual void setName(const std::string& name) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            for (auto& block : blocks) {
+                block->setName(name + " / " + profiler::typeName(typeid(*block)));
+            }
+        }
+
     private:
         virtual void doStart() {
             for (auto& block : blocks) {
@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "../buffer/buffer.h"
 
 namespace dsp::loop {
     template <class T>
@@ -10,6 +11,13 @@ namespace dsp::loop {
 
         AGC(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) { init(in, setPoint, attack, decay, maxGain, maxOutputAmp, initGain); }
 
+        ~AGC() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(ampBuf);
+            buffer::free(peakBuf);
+        }
+
         void init(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) {
             _setPoint = setPoint;
             _attack = attack;
@@ -20,6 +28,10 @@ namespace dsp::loop {
             _maxOutputAmp = maxOutputAmp;
             _initGain = initGain;
             amp = _setPoint / _initGain;
+
+            ampBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            peakBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+
             base_type::init(in);
         }
 
@@ -68,15 +80,19 @@ namespace dsp::loop {
         }
 
         inline int process(int count, T* in, T* out) {
+            // Get all amplitudes at once
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)in, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                for (int i = 0; i < count; i++) { ampBuf[i] = fabsf(in[i]); }
+            }
+
+            // Run the average, only this part is sequential. The gains replace the amplitudes as they're used.
+            bool peaksReady = false;
             for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp, gain;
-                if constexpr (std::is_same_v<T, complex_t>) {
-                    inAmp = in[i].amplitude();
-                }
-                if constexpr (std::is_same_v<T, float>) {
-                    inAmp = fabsf(in[i]);
-                }
+                float inAmp = ampBuf[i];
+                float gain;
 
                 // Update average amplitude
                 if (inAmp != 0.0f) {
@@ -87,24 +103,29 @@ namespace dsp::loop {
                     gain = 1.0f;
                 }
 
-                // If clipping is detected look ahead and correct
+                // If clipping is detected look ahead and correct, the peaks of what's left are found in one backwards pass
                 if (inAmp*gain > _maxOutputAmp) {
-                    float maxAmp = 0;
-                    for (int j = i; j < count; j++) {
-                        if constexpr (std::is_same_v<T, complex_t>) {
-                            inAmp = in[j].amplitude();
+                    if (!peaksReady) {
+                        float maxAmp = 0.0f;
+                        for (int j = count - 1; j >= i; j--) {
+                            if (ampBuf[j] > maxAmp) { maxAmp = ampBuf[j]; }
+                            peakBuf[j] = maxAmp;
                         }
-                        if constexpr (std::is_same_v<T, float>) {
-                            inAmp = fabsf(in[j]);
-                        }
-                        if (inAmp > maxAmp) { maxAmp = inAmp; }
+                        peaksReady = true;
                     }
-                    amp = maxAmp;
+                    amp = peakBuf[i];
                     gain = std::min<float>(_setPoint / amp, _maxGain);
                 }
-                
-                // Scale output by gain
-                out[i] = in[i] * gain;
+
+                ampBuf[i] = gain;
+            }
+
+            // Scale output by gain
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, ampBuf, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                volk_32f_x2_multiply_32f(out, in, ampBuf, count);
             }
             return count;
         }
@@ -132,5 +153,7 @@ namespace dsp::loop {
 
         float amp = 1.0;
 
+        float* ampBuf = NULL;
+        float* peakBuf = NULL;
     };
 }
\ No newline at end of file
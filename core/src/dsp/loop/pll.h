@@ -1,7 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../math/normalize_phase.h"
-#include "../math/phasor.h"
+#include "../math/nco.h"
 #include "phase_control_loop.h"
 
 namespace dsp::loop {
@@ -63,7 +63,7 @@ namespace dsp::loop {
 
         virtual inline int process(int count, complex_t* in, complex_t* out) {
             for (int i = 0; i < count; i++) {
-                out[i] = math::phasor(pcl.phase);
+                out[i] = math::NCO::phasor(pcl.phase);
                 pcl.advance(math::normalizePhase(in[i].phase() - pcl.phase));
             }
             return count;
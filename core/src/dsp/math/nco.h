@@ -0,0 +1,50 @@
+#pragma once
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "../types.h"
+#include "constants.h"
+
+// Number of entries in the NCO table, must be a power of two
+#define NCO_TABLE_SIZE  1024
+
+namespace dsp::math {
+    // Table driven replacement for phasor() meant for the per-sample oscillator of phase tracking loops.
+    // The phase is split into the nearest table entry and a residual below pi/NCO_TABLE_SIZE, which is applied as
+    // a small angle rotation: at that size cos(r) = 1 - r^2/2 and sin(r) = r are exact to a few 1e-9.
+    // Results are within 2e-7 of the exact values for phases in +-4pi, precision slowly degrades beyond that.
+    class NCO {
+    public:
+        static inline complex_t phasor(float phase) {
+            // Adding 1.5*2^23 rounds to the nearest integer and leaves it in the low bits of the mantissa
+            const float ROUNDING = 12582912.0f;
+            float x = (phase * (float)(NCO_TABLE_SIZE / (2.0 * DB_M_PI))) + ROUNDING;
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(uint32_t));
+            float id = x - ROUNDING;
+
+            // The table step is split in two so that the residual keeps the low bits of the phase
+            float r = (phase - (id * STEP_HIGH)) - (id * STEP_LOW);
+            const complex_t& c = table.values[bits & (NCO_TABLE_SIZE - 1)];
+            float cr = 1.0f - (0.5f * r * r);
+            return { (c.re * cr) - (c.im * r), (c.im * cr) + (c.re * r) };
+        }
+
+    private:
+        // Table step truncated to 2^-20 so that its product with any id up to 2048 is exact, and the remainder
+        static constexpr float STEP_HIGH = (float)((double)(int64_t)((2.0 * DB_M_PI / NCO_TABLE_SIZE) * 1048576.0) / 1048576.0);
+        static constexpr float STEP_LOW = (float)((2.0 * DB_M_PI / NCO_TABLE_SIZE) - (double)STEP_HIGH);
+
+        struct Table {
+            Table() {
+                for (int i = 0; i < NCO_TABLE_SIZE; i++) {
+                    double angle = 2.0 * DB_M_PI * (double)i / (double)NCO_TABLE_SIZE;
+                    values[i] = { (float)cos(angle), (float)sin(angle) };
+                }
+            }
+            complex_t values[NCO_TABLE_SIZE];
+        };
+
+        static inline const Table table;
+    };
+}
@@ -1,6 +1,6 @@
 #pragma once
 #include "../processor.h"
-#include "../math/phasor.h"
+#include "../math/nco.h"
 #include "../math/normalize_phase.h"
 #include "../math/hz_to_rads.h"
 
@@ -44,7 +44,7 @@ namespace dsp::mod {
         inline int process(int count, const float* in, complex_t* out) {
             for (int i = 0; i < count; i++) {
                 phase = math::normalizePhase(phase + (_deviation * in[i]));
-                out[i] = math::phasor(phase);
+                out[i] = math::NCO::phasor(phase);
             }
             return count;
         }
@@ -0,0 +1,199 @@
+#pragma once
+#include <vector>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+#include "../types.h"
+#include "../stream.h"
+#include "../buffer/buffer.h"
+#include "../taps/tap.h"
+
+// Number of outputs computed together, small enough for the block and its inputs to stay in L1
+#define POLYPHASE_DECIMATOR_BLOCK_SIZE  256
+
+namespace dsp::multirate {
+    // Decimating FIR kernel with real taps, producing the same output as filter::DecimatingFIR.
+    // The input is split into one stream per phase so that every tap becomes a multiply-add over a block of
+    // outputs, which vectorizes without reordering sums. Symmetric taps are folded to use one multiply for
+    // two inputs and zero taps (eg. odd taps of half-band filters) are skipped entirely.
+    // Only the last few samples of each phase are kept between calls, the input is never copied as a whole.
+    template <class T>
+    class PolyphaseDecimator {
+    public:
+        static_assert(std::is_same_v<T, float> || std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>);
+
+        PolyphaseDecimator() {}
+
+        PolyphaseDecimator(tap<float>& taps, int decimation) { init(taps, decimation); }
+
+        ~PolyphaseDecimator() { free(); }
+
+        void init(tap<float>& taps, int decimation) {
+            free();
+            _decimation = decimation;
+            tapCount = taps.size;
+            tapsPerPhase = (tapCount + _decimation - 1) / _decimation;
+            buildTerms(taps);
+
+            // Enough room for the history, a partial row and the largest possible input
+            capacity = tapsPerPhase + (STREAM_BUFFER_SIZE / _decimation) + 4;
+            for (int i = 0; i < _decimation; i++) {
+                phases.push_back(buffer::alloc<T>(capacity));
+            }
+            zeros = buffer::alloc<float>(POLYPHASE_DECIMATOR_BLOCK_SIZE * 2);
+            buffer::clear(zeros, POLYPHASE_DECIMATOR_BLOCK_SIZE * 2);
+            reset();
+        }
+
+        void free() {
+            for (auto& phase : phases) { buffer::free(phase); }
+            if (zeros) { buffer::free(zeros); }
+            phases.clear();
+            terms.clear();
+            zeros = NULL;
+        }
+
+        void reset() {
+            // The filter starts with taps-1 zeros of history, just like the direct form
+            for (auto& phase : phases) { buffer::clear(phase, capacity); }
+            int history = tapCount - 1;
+            rows = history / _decimation;
+            rowFill = history % _decimation;
+        }
+
+        // Can safely be called in place, the input is fully consumed before any output is written
+        inline int process(int count, const T* in, T* out) {
+            append(count, in);
+
+            // An output needs a full row in every phase for each of its taps
+            int outCount = std::max<int>(rows - (tapsPerPhase - 1), 0);
+            constexpr int width = sizeof(T) / sizeof(float);
+            for (int start = 0; start < outCount; start += POLYPHASE_DECIMATOR_BLOCK_SIZE) {
+                int n = std::min<int>(outCount - start, POLYPHASE_DECIMATOR_BLOCK_SIZE) * width;
+                float* y = (float*)&out[start];
+                std::fill(y, y + n, 0.0f);
+
+                // Terms are applied four at a time to cut down on loads and stores of the outputs
+                int termCount = terms.size();
+                int t = 0;
+                for (; t + 4 <= termCount; t += 4) {
+                    float c0 = terms[t].coef, c1 = terms[t + 1].coef, c2 = terms[t + 2].coef, c3 = terms[t + 3].coef;
+                    const float* a0 = input(terms[t].phaseA, start + terms[t].offsetA);
+                    const float* b0 = input(terms[t].phaseB, start + terms[t].offsetB);
+                    const float* a1 = input(terms[t + 1].phaseA, start + terms[t + 1].offsetA);
+                    const float* b1 = input(terms[t + 1].phaseB, start + terms[t + 1].offsetB);
+                    const float* a2 = input(terms[t + 2].phaseA, start + terms[t + 2].offsetA);
+                    const float* b2 = input(terms[t + 2].phaseB, start + terms[t + 2].offsetB);
+                    const float* a3 = input(terms[t + 3].phaseA, start + terms[t + 3].offsetA);
+                    const float* b3 = input(terms[t + 3].phaseB, start + terms[t + 3].offsetB);
+                    for (int j = 0; j < n; j++) {
+                        y[j] += (c0 * (a0[j] + b0[j])) + (c1 * (a1[j] + b1[j])) + (c2 * (a2[j] + b2[j])) + (c3 * (a3[j] + b3[j]));
+                    }
+                }
+                for (; t < termCount; t++) {
+                    float c = terms[t].coef;
+                    const float* a = input(terms[t].phaseA, start + terms[t].offsetA);
+                    const float* b = input(terms[t].phaseB, start + terms[t].offsetB);
+                    for (int j = 0; j < n; j++) { y[j] += c * (a[j] + b[j]); }
+                }
+            }
+
+            // Keep the rows still needed by the next outputs, including the partial one
+            if (outCount) {
+                int keep = rows - outCount;
+                for (auto& phase : phases) {
+                    memmove(phase, &phase[outCount], (keep + 1) * sizeof(T));
+                }
+                rows = keep;
+            }
+            return outCount;
+        }
+
+        int getDecimation() { return _decimation; }
+
+    private:
+        // A tap on its own is stored as a pair with a zero row so that all terms go through the same loop
+        struct Term {
+            float coef;
+            int phaseA;
+            int offsetA;
+            int phaseB;
+            int offsetB;
+        };
+
+        inline const float* input(int phase, int row) {
+            return (phase < 0) ? zeros : (const float*)&phases[phase][row];
+        }
+
+        void buildTerms(tap<float>& taps) {
+            // Output m is the sum of taps[i] * in[m*decim + i], tap i reads phase i % decim at row m + i / decim
+            float maxTap = 0.0f;
+            for (int i = 0; i < tapCount; i++) { maxTap = std::max<float>(maxTap, fabsf(taps.taps[i])); }
+            float tolerance = maxTap * 1e-6f;
+            bool symmetric = true;
+            for (int i = 0; i < tapCount / 2; i++) {
+                if (fabsf(taps.taps[i] - taps.taps[tapCount - 1 - i]) > tolerance) {
+                    symmetric = false;
+                    break;
+                }
+            }
+
+            int count = symmetric ? (tapCount + 1) / 2 : tapCount;
+            for (int i = 0; i < count; i++) {
+                if (taps.taps[i] == 0.0f) { continue; }
+                Term t;
+                t.coef = taps.taps[i];
+                t.phaseA = i % _decimation;
+                t.offsetA = i / _decimation;
+                int j = tapCount - 1 - i;
+                bool paired = symmetric && (j != i);
+                t.phaseB = paired ? (j % _decimation) : -1;
+                t.offsetB = paired ? (j / _decimation) : 0;
+                terms.push_back(t);
+            }
+        }
+
+        inline void append(int count, const T* in) {
+            int i = 0;
+
+            // Finish the partial row first
+            if (rowFill) {
+                for (; i < count && rowFill < _decimation; i++) {
+                    phases[rowFill++][rows] = in[i];
+                }
+                if (rowFill == _decimation) {
+                    rowFill = 0;
+                    rows++;
+                }
+            }
+
+            // Then distribute the full rows, each phase is written contiguously
+            int fullRows = (count - i) / _decimation;
+            for (int p = 0; p < _decimation; p++) {
+                T* dst = &phases[p][rows];
+                const T* src = &in[i + p];
+                for (int r = 0; r < fullRows; r++) {
+                    dst[r] = src[r * _decimation];
+                }
+            }
+            rows += fullRows;
+            i += fullRows * _decimation;
+
+            // And start a new partial row with what's left
+            for (; i < count; i++) {
+                phases[rowFill++][rows] = in[i];
+            }
+        }
+
+        int _decimation = 1;
+        int tapCount = 0;
+        int tapsPerPhase = 0;
+        int capacity = 0;
+        std::vector<Term> terms;
+        std::vector<T*> phases;
+        float* zeros = NULL;
+        int rows = 0;
+        int rowFill = 0;
+    };
+}
@@ -2,6 +2,7 @@
 #include "../processor.h"
 #include "../taps/tap.h"
 #include "polyphase_bank.h"
+#include "../filter/fixed_fir.h"
 
 namespace dsp::multirate {
     template<class T>
@@ -26,6 +27,7 @@ namespace dsp::multirate {
 
             // Build filter bank
             phases = buildPolyphaseBank(_interp, _taps);
+            selectKernel();
 
             // Allocate delay buffer
             buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
@@ -48,6 +50,7 @@ namespace dsp::multirate {
             // Re-generate polyphase bank
             freePolyphaseBank(phases);
             phases = buildPolyphaseBank(_interp, _taps);
+            selectKernel();
 
             // Reset buffer
             bufStart = &buffer[phases.tapsPerPhase - 1];
@@ -67,29 +70,10 @@ namespace dsp::multirate {
         }
 
         inline int process(int count, const T* in, T* out) {
-            int outCount = 0;
-
             // Copy input to buffer
             memcpy(bufStart, in, count * sizeof(T));
 
-            while (offset < count) {
-                // Do convolution
-                if constexpr (std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &buffer[offset], phases.phases[phase], phases.tapsPerPhase);
-                }
-                if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&buffer[offset], phases.phases[phase], phases.tapsPerPhase);
-                }
-
-                // Increment phase
-                phase += _decim;
-
-                // Branchless phase advance if phase wrap arround occurs
-                offset += phase / _interp;
-
-                // Wrap around if needed
-                phase = phase % _interp;
-            }
+            int outCount = (this->*kernel)(count, out);
             offset -= count;
 
             // Move delay
@@ -113,6 +97,38 @@ namespace dsp::multirate {
         }
 
     protected:
+        // N is the number of taps per phase when known at compile time, 0 otherwise
+        template <int N>
+        int resample(int count, T* out) {
+            int outCount = 0;
+            while (offset < count) {
+                // Do convolution
+                if constexpr (N != 0) {
+                    out[outCount++] = filter::fixedDot<N>(&buffer[offset], phases.phases[phase]);
+                }
+                else if constexpr (std::is_same_v<T, float>) {
+                    volk_32f_x2_dot_prod_32f(&out[outCount++], &buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                }
+                else if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&buffer[offset], phases.phases[phase], phases.tapsPerPhase);
+                }
+
+                // Increment phase
+                phase += _decim;
+
+                // Branchless phase advance if phase wrap arround occurs
+                offset += phase / _interp;
+
+                // Wrap around if needed
+                phase = phase % _interp;
+            }
+            return outCount;
+        }
+
+        void selectKernel() {
+            kernel = filter::dispatchTapCount(phases.tapsPerPhase, [](auto n) { return &PolyphaseResampler::resample<decltype(n)::value>; });
+        }
+
         int _interp;
         int _decim;
         tap<float> _taps;
@@ -121,6 +137,7 @@ namespace dsp::multirate {
         int offset = 0;
         T* buffer;
         T* bufStart;
+        int (PolyphaseResampler::*kernel)(int count, T* out);
 
     };
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "../filter/decimating_fir.h"
 #include "../taps/from_array.h"
+#include "polyphase_decimator.h"
 #include "decim/plans.h"
 
 namespace dsp::multirate {
@@ -42,8 +43,9 @@ namespace dsp::multirate {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            for (auto& fir : decimFirs) {
-                fir->reset();
+            for (auto& stage : stages) {
+                if (stage.fir) { stage.fir->reset(); }
+                if (stage.poly) { stage.poly->reset(); }
             }
             base_type::tempStart();
         }
@@ -57,10 +59,8 @@ namespace dsp::multirate {
             
             // Process data through each stage
             const T* data = in;
-            int last = stageCount - 1;
-            for (int i = 0; i < stageCount; i++) {
-                auto fir = decimFirs[i];
-                count = fir->process(count, data, out);
+            for (auto& stage : stages) {
+                count = stage.poly ? stage.poly->process(count, data, out) : stage.fir->process(count, data, out);
                 data = out;
             }
             return count;
@@ -82,9 +82,12 @@ namespace dsp::multirate {
 
     protected:
         void freeFirs() {
-            for (auto& fir : decimFirs) { delete fir; }
+            for (auto& stage : stages) {
+                if (stage.fir) { delete stage.fir; }
+                if (stage.poly) { delete stage.poly; }
+            }
             for (auto& taps : decimTaps) { taps::free(taps); }
-            decimFirs.clear();
+            stages.clear();
             decimTaps.clear();
         }
 
@@ -99,10 +102,19 @@ namespace dsp::multirate {
                 stageCount = plan.stageCount;
                 for (int i = 0; i < stageCount; i++) {
                     tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
-                    auto fir = new filter::DecimatingFIR<T, float>(NULL, taps, plan.stages[i].decimation);
-                    fir->out.free();
+                    int decimation = plan.stages[i].decimation;
+
+                    // Stages long enough for the FFT convolution keep using it, the others get the polyphase kernel
+                    Stage stage;
+                    if ((int)taps.size / decimation >= FIR_FFT_TAP_THRESHOLD) {
+                        stage.fir = new filter::DecimatingFIR<T, float>(NULL, taps, decimation);
+                        stage.fir->out.free();
+                    }
+                    else {
+                        stage.poly = new PolyphaseDecimator<T>(taps, decimation);
+                    }
                     decimTaps.push_back(taps);
-                    decimFirs.push_back(fir);
+                    stages.push_back(stage);
                 }
             }
         }
@@ -112,7 +124,12 @@ namespace dsp::multirate {
             return ((ratio & (ratio - 1)) == 0) && ratio && ratio <= getMaxRatio();
         }
 
-        std::vector<filter::DecimatingFIR<T, float>*> decimFirs;
+        struct Stage {
+            filter::DecimatingFIR<T, float>* fir = NULL;
+            PolyphaseDecimator<T>* poly = NULL;
+        };
+
+        std::vector<Stage> stages;
         std::vector<tap<float>> decimTaps;
         unsigned int _ratio;
         int stageCount;
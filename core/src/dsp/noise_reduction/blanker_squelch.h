@@ -0,0 +1,101 @@
+#pragma once
+#include "../processor.h"
+#include "noise_blanker.h"
+#include "squelch.h"
+
+namespace dsp::noise_reduction {
+    // Noise blanker followed by a squelch in a single pass over the block, used when both are enabled.
+    // The amplitude of the blanked signal is the input amplitude times the blanking gain, so the magnitudes
+    // are only computed once and the squelch level comes from their dot product with the gains.
+    class BlankerSquelch : public Processor<complex_t, complex_t> {
+        using base_type = Processor<complex_t, complex_t>;
+    public:
+        BlankerSquelch() {}
+
+        BlankerSquelch(stream<complex_t>* in, double rate, double level, double squelchLevel) { init(in, rate, level, squelchLevel); }
+
+        ~BlankerSquelch() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(ampBuf);
+            buffer::free(gainBuf);
+        }
+
+        void init(stream<complex_t>* in, double rate, double level, double squelchLevel) {
+            _rate = rate;
+            _invRate = 1.0f - _rate;
+            _level = level;
+            _squelchLevel = squelchLevel;
+
+            ampBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+
+            base_type::init(in);
+        }
+
+        void setRate(double rate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _rate = rate;
+            _invRate = 1.0f - _rate;
+        }
+
+        void setLevel(double level) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _level = level;
+        }
+
+        void setSquelchLevel(double level) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _squelchLevel = level;
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            amp = 1.0f;
+        }
+
+        inline int process(int count, complex_t* in, complex_t* out) {
+            volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)in, count);
+            NoiseBlanker::computeGains(count, ampBuf, gainBuf, amp, _rate, _invRate, _level);
+
+            // Mean amplitude after blanking
+            float sum;
+            volk_32f_x2_dot_prod_32f(&sum, ampBuf, gainBuf, count);
+            sum /= (float)count;
+
+            if (Squelch::isOpen(sum, _squelchLevel)) {
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, gainBuf, count);
+            }
+            else {
+                memset(out, 0, count * sizeof(complex_t));
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            base_type::_in->flush();
+            if (!base_type::out.swap(count)) { return -1; }
+            return count;
+        }
+
+    protected:
+        float _rate;
+        float _invRate;
+        float _level;
+        float _squelchLevel;
+
+        float amp = 1.0;
+
+        float* ampBuf;
+        float* gainBuf;
+    };
+}
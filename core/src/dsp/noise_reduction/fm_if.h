@@ -3,7 +3,17 @@
 #include "../window/nuttall.h"
 #include <fftw3.h>
 
+// Number of samples between two searches of the strongest bin over the whole spectrum
+#define FMIF_RESCAN_INTERVAL    16
+
+// Number of bins on each side of the current peak evaluated for every sample
+#define FMIF_SEARCH_RADIUS      2
+
 namespace dsp::noise_reduction {
+    // Keeps only the strongest bin of a sliding windowed DFT of the input. Instead of a forward and inverse FFT
+    // for every sample (see FFTFMIF), the whole spectrum is only computed every FMIF_RESCAN_INTERVAL samples.
+    // In between, the peak is tracked by evaluating the few bins around it directly, since it moves little
+    // from one sample to the next. The inverse FFT of a single bin reduces to a rotation.
     class FMIF : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
     public:
@@ -38,39 +48,51 @@ namespace dsp::noise_reduction {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             buffer::clear(buffer, _bins - 1);
-            buffer::clear(backFFTIn, _bins);
+            peak = 0;
+            sinceRescan = FMIF_RESCAN_INTERVAL;
             base_type::tempStart();
         }
 
         int process(int count, const complex_t* in, complex_t* out) {
-            // Write new input data to buffer buffer
+            // Write new input data to buffer
             memcpy(bufferStart, in, count * sizeof(complex_t));
-            
-            // Iterate the FFT
-            for (int i = 0; i < count; i++) {
-                // Apply windows
-                volk_32fc_32f_multiply_32fc((lv_32fc_t*)forwFFTIn, (lv_32fc_t*)&buffer[i], fftWin, _bins);
-
-                // Do forward FFT
-                fftwf_execute(forwardPlan);
 
-                // Process bins here
-                uint32_t idx;
-                volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)forwFFTOut, _bins);
-                volk_32f_index_max_32u(&idx, ampBuf, _bins);
-
-                // Keep only the bin of highest amplitude
-                backFFTIn[idx] = forwFFTOut[idx];
-
-                // Do reverse FFT and get first element
-                fftwf_execute(backwardPlan);
-                out[i] = backFFTOut[_bins / 2];
-
-                // Reset the input buffer
-                backFFTIn[idx] = { 0, 0 };
+            for (int i = 0; i < count; i++) {
+                complex_t val;
+                if (++sinceRescan >= FMIF_RESCAN_INTERVAL) {
+                    // Compute the whole spectrum and find the strongest bin
+                    uint32_t idx;
+                    volk_32fc_32f_multiply_32fc((lv_32fc_t*)fftIn, (lv_32fc_t*)&buffer[i], fftWin, _bins);
+                    fftwf_execute(fftPlan);
+                    volk_32fc_magnitude_squared_32f(ampBuf, (lv_32fc_t*)fftOut, _bins);
+                    volk_32f_index_max_32u(&idx, ampBuf, _bins);
+                    peak = idx;
+                    val = fftOut[peak];
+                    sinceRescan = 0;
+                }
+                else {
+                    // Only evaluate the bins around the last peak
+                    float maxPow = -1.0f;
+                    int first = peak - std::min<int>(FMIF_SEARCH_RADIUS, (_bins - 1) / 2);
+                    int last = peak + std::min<int>(FMIF_SEARCH_RADIUS, _bins / 2);
+                    for (int j = first; j <= last; j++) {
+                        int k = (j + _bins) % _bins;
+                        complex_t bin;
+                        volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&bin, (lv_32fc_t*)&buffer[i], (lv_32fc_t*)&kernels[k * _bins], _bins);
+                        float pow = (bin.re * bin.re) + (bin.im * bin.im);
+                        if (pow > maxPow) {
+                            maxPow = pow;
+                            val = bin;
+                            peak = k;
+                        }
+                    }
+                }
+
+                // Inverse DFT of the strongest bin alone, taken at the center of the window
+                out[i] = val * centerRot[peak];
             }
 
-            // Move buffer buffer
+            // Move buffer
             memmove(buffer, &buffer[count], (_bins - 1) * sizeof(complex_t));
 
             return count;
@@ -91,19 +113,14 @@ namespace dsp::noise_reduction {
     protected:
         void initBuffers() {
             // Allocate FFT buffers
-            forwFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
-            forwFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
-            backFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
-            backFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
+            fftIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
 
             // Allocate and clear delay buffer
             buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + 64000);
             bufferStart = &buffer[_bins - 1];
             buffer::clear(buffer, _bins - 1);
 
-            // Clear backward FFT input since only one value is changed and reset at a time
-            buffer::clear(backFFTIn, _bins);
-
             // Allocate amplitude buffer
             ampBuf = buffer::alloc<float>(_bins);
 
@@ -111,39 +128,54 @@ namespace dsp::noise_reduction {
             fftWin = buffer::alloc<float>(_bins);
             for (int i = 0; i < _bins; i++) { fftWin[i] = window::nuttall(i, _bins - 1); }
 
-            // Plan FFTs
-            forwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD, FFTW_ESTIMATE);
-            backwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            // Generate the windowed DFT kernel of every bin and the rotation from the start to the center of the window
+            kernels = buffer::alloc<complex_t>(_bins * _bins);
+            centerRot = buffer::alloc<complex_t>(_bins);
+            for (int k = 0; k < _bins; k++) {
+                for (int n = 0; n < _bins; n++) {
+                    double phase = -2.0 * DB_M_PI * (double)((k * n) % _bins) / (double)_bins;
+                    kernels[k * _bins + n] = { (float)(fftWin[n] * cos(phase)), (float)(fftWin[n] * sin(phase)) };
+                }
+                double phase = 2.0 * DB_M_PI * (double)((k * (_bins / 2)) % _bins) / (double)_bins;
+                centerRot[k] = { (float)cos(phase), (float)sin(phase) };
+            }
+
+            // Plan FFT
+            fftPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut, FFTW_FORWARD, FFTW_ESTIMATE);
+
+            // Start with a search over the whole spectrum
+            peak = 0;
+            sinceRescan = FMIF_RESCAN_INTERVAL;
         }
 
         void destroyBuffers() {
-            fftwf_destroy_plan(forwardPlan);
-            fftwf_destroy_plan(backwardPlan);
-            fftwf_free(forwFFTIn);
-            fftwf_free(forwFFTOut);
-            fftwf_free(backFFTIn);
-            fftwf_free(backFFTOut);
+            fftwf_destroy_plan(fftPlan);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
             buffer::free(buffer);
             buffer::free(ampBuf);
             buffer::free(fftWin);
+            buffer::free(kernels);
+            buffer::free(centerRot);
         }
 
-        complex_t* forwFFTIn;
-        complex_t* forwFFTOut;
-        complex_t* backFFTIn;
-        complex_t* backFFTOut;
-
-        fftwf_plan forwardPlan;
-        fftwf_plan backwardPlan;
+        complex_t* fftIn;
+        complex_t* fftOut;
+        fftwf_plan fftPlan;
 
         complex_t* buffer;
         complex_t* bufferStart;
 
         float* fftWin;
-
         float* ampBuf;
 
+        complex_t* kernels;
+        complex_t* centerRot;
+
+        int peak;
+        int sinceRescan;
+
         int _bins;
 
-    }; 
-}
\ No newline at end of file
+    };
+}
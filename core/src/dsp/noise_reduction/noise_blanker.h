@@ -1,5 +1,6 @@
 #pragma once
 #include "../processor.h"
+#include "../buffer/buffer.h"
 
 namespace dsp::noise_reduction {
     class NoiseBlanker : public Processor<complex_t, complex_t> {
@@ -9,10 +10,21 @@ namespace dsp::noise_reduction {
 
         NoiseBlanker(stream<complex_t>* in, double rate, double level) { init(in, rate, level); }
 
+        ~NoiseBlanker() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(ampBuf);
+            buffer::free(gainBuf);
+        }
+
         void init(stream<complex_t>* in, double rate, double level) {
             _rate = rate;
             _invRate = 1.0f - _rate;
             _level = level;
+
+            ampBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            gainBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+
             base_type::init(in);
         }
 
@@ -36,24 +48,26 @@ namespace dsp::noise_reduction {
         }
 
         inline int process(int count, complex_t* in, complex_t* out) {
+            volk_32fc_magnitude_32f(ampBuf, (lv_32fc_t*)in, count);
+            computeGains(count, ampBuf, gainBuf, amp, _rate, _invRate, _level);
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, gainBuf, count);
+            return count;
+        }
+
+        // Blanking gains from the amplitudes of the input, amp is the running average amplitude.
+        // Only the average is sequential, the gains are computed in a separate loop that vectorizes.
+        static inline void computeGains(int count, const float* amps, float* gains, float& amp, float rate, float invRate, float level) {
+            // Update average amplitude, skipping samples that are exactly zero
             for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp = in[i].amplitude();
-
-                // Update average amplitude
-                float gain = 1.0f;
-                if (inAmp != 0.0f) {
-                    amp = (amp * _invRate) + (inAmp * _rate);
-                    float excess = inAmp / amp;
-                    if (excess > _level) {
-                        gain = 1.0f / excess;
-                    }
-                }
-                
-                // Scale output by gain
-                out[i] = in[i] * gain;
+                if (amps[i] != 0.0f) { amp = (amp * invRate) + (amps[i] * rate); }
+                gains[i] = amp;
+            }
+
+            // Attenuate anything too far above the average back down to it
+            for (int i = 0; i < count; i++) {
+                float excess = amps[i] / gains[i];
+                gains[i] = (amps[i] != 0.0f && excess > level) ? (1.0f / excess) : 1.0f;
             }
-            return count;
         }
 
         int run() {
@@ -74,5 +88,7 @@ namespace dsp::noise_reduction {
 
         float amp = 1.0;
 
+        float* ampBuf;
+        float* gainBuf;
     };
-}
\ No newline at end of file
+}
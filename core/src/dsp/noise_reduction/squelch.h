@@ -36,7 +36,7 @@ namespace dsp::noise_reduction {
             volk_32f_accumulator_s32f(&sum, normBuffer, count);
             sum /= (float)count;
 
-            if (10.0f * log10f(sum) >= _level) {
+            if (isOpen(sum, _level)) {
                 memcpy(out, in, count * sizeof(complex_t));
             }
             else {
@@ -46,6 +46,11 @@ namespace dsp::noise_reduction {
             return count;
         }
 
+        // Squelch decision from the mean amplitude of a block and a level in dB
+        static inline bool isOpen(float meanAmp, float level) {
+            return 10.0f * log10f(meanAmp) >= level;
+        }
+
         //DEFAULT_PROC_RUN();
 
         int run() {
@@ -0,0 +1,199 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+namespace dsp::profiler {
+    // Counters of a single block, only updated by the block's worker thread while profiling is enabled
+    struct BlockStats {
+        BlockStats(const std::string& name) : name(name) {}
+
+        std::string name;
+        std::atomic<uint64_t> id = 0;
+        std::atomic<uint64_t> runs = 0;
+        std::atomic<uint64_t> inSamples = 0;
+        std::atomic<uint64_t> outSamples = 0;
+        std::atomic<uint64_t> reads = 0;
+        std::atomic<uint64_t> readyReads = 0;
+        std::atomic<uint64_t> busyNs = 0;
+        std::atomic<uint64_t> readWaitNs = 0;
+        std::atomic<uint64_t> swapWaitNs = 0;
+    };
+
+    // Copy of the counters of a block at a given time
+    struct Snapshot {
+        std::string name;
+        uint64_t id;
+        uint64_t runs;
+        uint64_t inSamples;
+        uint64_t outSamples;
+        uint64_t reads;
+        uint64_t readyReads;
+        uint64_t busyNs;
+        uint64_t readWaitNs;
+        uint64_t swapWaitNs;
+    };
+
+    class Registry {
+    public:
+        std::shared_ptr<BlockStats> add(const std::string& name) {
+            std::lock_guard<std::mutex> lck(mtx);
+            auto stats = std::make_shared<BlockStats>(name);
+            stats->id = ++lastId;
+            blocks.push_back(stats);
+            return stats;
+        }
+
+        void remove(const std::shared_ptr<BlockStats>& stats) {
+            std::lock_guard<std::mutex> lck(mtx);
+            blocks.erase(std::remove(blocks.begin(), blocks.end(), stats), blocks.end());
+        }
+
+        std::vector<Snapshot> snapshot() {
+            std::lock_guard<std::mutex> lck(mtx);
+            std::vector<Snapshot> snaps;
+            for (auto& b : blocks) {
+                snaps.push_back({ b->name, b->id, b->runs, b->inSamples, b->outSamples, b->reads, b->readyReads, b->busyNs, b->readWaitNs, b->swapWaitNs });
+            }
+            return snaps;
+        }
+
+        // Serialize a snapshot as a count followed by, for each block, a length prefixed name and the counters
+        static std::vector<uint8_t> serialize(const std::vector<Snapshot>& snaps) {
+            std::vector<uint8_t> data;
+            append<uint32_t>(data, snaps.size());
+            for (auto& s : snaps) {
+                append<uint16_t>(data, s.name.size());
+                data.insert(data.end(), s.name.begin(), s.name.end());
+                for (uint64_t val : { s.id, s.runs, s.inSamples, s.outSamples, s.reads, s.readyReads, s.busyNs, s.readWaitNs, s.swapWaitNs }) {
+                    append<uint64_t>(data, val);
+                }
+            }
+            return data;
+        }
+
+        static bool deserialize(const uint8_t* data, int len, std::vector<Snapshot>& snaps) {
+            snaps.clear();
+            int i = 0;
+            uint32_t count;
+            if (!extract(data, len, i, count)) { return false; }
+            for (uint32_t n = 0; n < count; n++) {
+                Snapshot s;
+                uint16_t nameLen;
+                if (!extract(data, len, i, nameLen) || i + nameLen > len) { return false; }
+                s.name = std::string((const char*)&data[i], nameLen);
+                i += nameLen;
+                for (uint64_t* val : { &s.id, &s.runs, &s.inSamples, &s.outSamples, &s.reads, &s.readyReads, &s.busyNs, &s.readWaitNs, &s.swapWaitNs }) {
+                    if (!extract(data, len, i, *val)) { return false; }
+                }
+                snaps.push_back(s);
+            }
+            return true;
+        }
+
+    private:
+        template <class T>
+        static void append(std::vector<uint8_t>& data, T val) {
+            uint8_t buf[sizeof(T)];
+            memcpy(buf, &val, sizeof(T));
+            data.insert(data.end(), buf, buf + sizeof(T));
+        }
+
+        template <class T>
+        static bool extract(const uint8_t* data, int len, int& i, T& val) {
+            if (i + (int)sizeof(T) > len) { return false; }
+            memcpy(&val, &data[i], sizeof(T));
+            i += sizeof(T);
+            return true;
+        }
+
+        std::mutex mtx;
+        std::vector<std::shared_ptr<BlockStats>> blocks;
+        uint64_t lastId = 0;
+    };
+
+    inline Registry& registry() {
+        static Registry reg;
+        return reg;
+    }
+
+    inline std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag = false;
+        return flag;
+    }
+
+    inline bool isEnabled() {
+        return enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    inline void setEnabled(bool enabled) {
+        enabledFlag() = enabled;
+    }
+
+    // Stats of the block whose worker thread is the current thread, NULL when not profiling
+    inline thread_local BlockStats* current = NULL;
+
+    inline uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Human readable name of a block type, without the namespaces of its template arguments
+    inline std::string typeName(const std::type_info& type) {
+        std::string name = type.name();
+#ifdef __GNUG__
+        int status;
+        char* demangled = abi::__cxa_demangle(name.c_str(), NULL, NULL, &status);
+        if (status == 0 && demangled) { name = demangled; }
+        ::free(demangled);
+#endif
+        size_t pos;
+        while ((pos = name.find("dsp::")) != std::string::npos) { name.erase(pos, 5); }
+        return name;
+    }
+
+    inline void countRead(bool ready, int count) {
+        BlockStats* stats = current;
+        if (!stats) { return; }
+        stats->reads.fetch_add(1, std::memory_order_relaxed);
+        if (ready) { stats->readyReads.fetch_add(1, std::memory_order_relaxed); }
+        if (count > 0) { stats->inSamples.fetch_add(count, std::memory_order_relaxed); }
+    }
+
+    inline void countSwap(int count) {
+        BlockStats* stats = current;
+        if (!stats || count <= 0) { return; }
+        stats->outSamples.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Measures the time spent waiting on a stream for the block running on the current thread, if any
+    class WaitTimer {
+    public:
+        WaitTimer(std::atomic<uint64_t> BlockStats::*counter) {
+            stats = current;
+            if (!stats) { return; }
+            _counter = counter;
+            start = now();
+        }
+
+        ~WaitTimer() {
+            if (!stats) { return; }
+            (stats->*_counter).fetch_add(now() - start, std::memory_order_relaxed);
+        }
+
+    private:
+        BlockStats* stats;
+        std::atomic<uint64_t> BlockStats::*_counter;
+        uint64_t start;
+    };
+}
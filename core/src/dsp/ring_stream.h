@@ -0,0 +1,244 @@
+#pragma once
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include "stream.h"
+
+// Number of times a waiting side polls before parking on its condition variable
+#define RING_STREAM_SPIN_COUNT  1024
+
+// Default number of buffers in the ring
+#define RING_STREAM_DEFAULT_DEPTH   4
+
+namespace dsp {
+    // Single-producer/single-consumer stream backed by a ring of buffers instead of a double buffer.
+    // It has the same swap/read/flush contract as stream<T> so it can replace it anywhere a stream<T>* is
+    // used. The writer can queue up to depth-1 buffers ahead of the reader instead of waiting for every flush.
+    template <class T>
+    class ring_stream : public stream<T> {
+        using base_type = stream<T>;
+    public:
+        ring_stream(int depth = RING_STREAM_DEFAULT_DEPTH) {
+            assert(depth >= 2);
+            _depth = depth;
+            slots = new T*[_depth];
+            sizes = new int[_depth];
+            shared = new T*[_depth];
+            sharedRefs = new buffer::RefCount*[_depth];
+            sharedRounds = new uint64_t[_depth];
+
+            // Reuse the buffers already allocated by the base stream for the first two slots
+            slots[0] = base_type::writeBuf;
+            slots[1] = base_type::readBuf;
+            for (int i = 2; i < _depth; i++) {
+                slots[i] = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+            }
+            for (int i = 0; i < _depth; i++) {
+                shared[i] = NULL;
+            }
+
+            base_type::writeBuf = slots[0];
+            base_type::readBuf = slots[0];
+        }
+
+        ~ring_stream() {
+            free();
+            delete[] slots;
+            delete[] sizes;
+            delete[] shared;
+            delete[] sharedRefs;
+            delete[] sharedRounds;
+        }
+
+        void setBufferSize(int samples) {
+            free();
+            for (int i = 0; i < _depth; i++) {
+                slots[i] = buffer::alloc<T>(samples);
+            }
+            base_type::writeBuf = slots[head % _depth];
+            base_type::readBuf = slots[tail % _depth];
+        }
+
+        inline bool swap(int size) {
+            // Wait until the buffer after the one being written is released by the reader, or for a stop
+            uint64_t h = head.load(std::memory_order_relaxed);
+            {
+                profiler::WaitTimer timer(&profiler::BlockStats::swapWaitNs);
+                if (!waitFor([this, h]() { return (h + 1 - tail.load(std::memory_order_seq_cst)) < (uint64_t)_depth; }, writerStop, writerWaiting, swapMtx, swapCV)) {
+                    return false;
+                }
+            }
+            profiler::countSwap(size);
+
+            // Publish the buffer and move on to the next one
+            sizes[h % _depth] = size;
+            shared[h % _depth] = NULL;
+            head.store(h + 1, std::memory_order_seq_cst);
+            base_type::writeBuf = slots[(h + 1) % _depth];
+
+            // Wake up the reader only if it's parked
+            wake(readerWaiting, rdyMtx, rdyCV);
+            this->notifyReader();
+
+            return true;
+        }
+
+        inline bool swapShared(T* data, int size, buffer::RefCount* refs, uint64_t round) {
+            // Same as swap, but the slot points to the writer's buffer instead of its own
+            uint64_t h = head.load(std::memory_order_relaxed);
+            {
+                profiler::WaitTimer timer(&profiler::BlockStats::swapWaitNs);
+                if (!waitFor([this, h]() { return (h + 1 - tail.load(std::memory_order_seq_cst)) < (uint64_t)_depth; }, writerStop, writerWaiting, swapMtx, swapCV)) {
+                    return false;
+                }
+            }
+            profiler::countSwap(size);
+
+            sizes[h % _depth] = size;
+            shared[h % _depth] = data;
+            sharedRefs[h % _depth] = refs;
+            sharedRounds[h % _depth] = round;
+            head.store(h + 1, std::memory_order_seq_cst);
+            base_type::writeBuf = slots[(h + 1) % _depth];
+
+            wake(readerWaiting, rdyMtx, rdyCV);
+            this->notifyReader();
+
+            return true;
+        }
+
+        inline int read() {
+            // Wait for data to be ready or to be stopped
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            bool ready = head.load(std::memory_order_acquire) > t;
+            {
+                profiler::WaitTimer timer(&profiler::BlockStats::readWaitNs);
+                if (!waitFor([this, t]() { return head.load(std::memory_order_seq_cst) > t; }, readerStop, readerWaiting, rdyMtx, rdyCV)) {
+                    return -1;
+                }
+            }
+
+            base_type::readBuf = shared[t % _depth] ? shared[t % _depth] : slots[t % _depth];
+            profiler::countRead(ready, sizes[t % _depth]);
+            return sizes[t % _depth];
+        }
+
+        inline void flush() {
+            // Release the buffer being read, if any
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            if (head.load(std::memory_order_acquire) <= t) { return; }
+            if (shared[t % _depth]) {
+                base_type::readBuf = slots[t % _depth];
+                sharedRefs[t % _depth]->release(sharedRounds[t % _depth]);
+            }
+            tail.store(t + 1, std::memory_order_seq_cst);
+
+            // Wake up the writer only if it's parked
+            wake(writerWaiting, swapMtx, swapCV);
+            this->notifyWriter();
+        }
+
+        bool readable() {
+            return head.load(std::memory_order_acquire) > tail.load(std::memory_order_acquire) || readerStop.load();
+        }
+
+        bool writable() {
+            return (head.load(std::memory_order_acquire) + 1 - tail.load(std::memory_order_acquire)) < (uint64_t)_depth || writerStop.load();
+        }
+
+        void stopWriter() {
+            {
+                std::lock_guard<std::mutex> lck(swapMtx);
+                writerStop = true;
+            }
+            swapCV.notify_all();
+        }
+
+        void clearWriteStop() {
+            writerStop = false;
+        }
+
+        void stopReader() {
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                readerStop = true;
+            }
+            rdyCV.notify_all();
+        }
+
+        void clearReadStop() {
+            readerStop = false;
+        }
+
+        void free() {
+            for (int i = 0; i < _depth; i++) {
+                if (slots[i]) { buffer::free(slots[i]); }
+                slots[i] = NULL;
+            }
+
+            // Make sure the base class doesn't free the slots a second time
+            base_type::writeBuf = NULL;
+            base_type::readBuf = NULL;
+        }
+
+        int getDepth() {
+            return _depth;
+        }
+
+        // Number of buffers published by the writer but not yet released by the reader
+        int getOccupancy() {
+            return (int)(head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed));
+        }
+
+    private:
+        template <typename Func>
+        inline bool waitFor(Func ready, std::atomic<bool>& stop, std::atomic<bool>& waiting, std::mutex& mtx, std::condition_variable& cv) {
+            // Spin for a little while, most of the time the other side is only a few microseconds away
+            for (int i = 0; i < RING_STREAM_SPIN_COUNT; i++) {
+                if (stop.load(std::memory_order_relaxed)) { return false; }
+                if (ready()) { return true; }
+                if (i & 0xFF) { continue; }
+                std::this_thread::yield();
+            }
+
+            // Park until the other side signals or a stop is requested. ready() must load the other side's counter
+            // with seq_cst, otherwise that load could move before the store to waiting: the other side could then
+            // publish and see no waiter while this side sees no data, and the wakeup would be lost.
+            scheduler::Blocking blocking;
+            std::unique_lock<std::mutex> lck(mtx);
+            waiting.store(true, std::memory_order_seq_cst);
+            cv.wait(lck, [&]() { return ready() || stop.load(std::memory_order_relaxed); });
+            waiting.store(false, std::memory_order_relaxed);
+            return !stop.load(std::memory_order_relaxed);
+        }
+
+        inline void wake(std::atomic<bool>& waiting, std::mutex& mtx, std::condition_variable& cv) {
+            if (!waiting.load(std::memory_order_seq_cst)) { return; }
+            { std::lock_guard<std::mutex> lck(mtx); }
+            cv.notify_all();
+        }
+
+        int _depth;
+        T** slots;
+        int* sizes;
+
+        // Buffers handed out by the writer with swapShared, NULL when the slot's own buffer is used
+        T** shared;
+        buffer::RefCount** sharedRefs;
+        uint64_t* sharedRounds;
+
+        // Monotonic counters of published (head) and released (tail) buffers
+        std::atomic<uint64_t> head = 0;
+        std::atomic<uint64_t> tail = 0;
+
+        std::mutex swapMtx;
+        std::condition_variable swapCV;
+        std::atomic<bool> writerWaiting = false;
+        std::atomic<bool> writerStop = false;
+
+        std::mutex rdyMtx;
+        std::condition_variable rdyCV;
+        std::atomic<bool> readerWaiting = false;
+        std::atomic<bool> readerStop = false;
+    };
+}
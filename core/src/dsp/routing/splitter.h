@@ -1,6 +1,9 @@
 #pragma once
 #include "../sink.h"
 
+// Number of buffers the readers can hold at once in shared mode before the splitter has to wait for them
+#define SPLITTER_SHARED_POOL_SIZE   3
+
 namespace dsp::routing {
     template <class T>
     class Splitter : public Sink<T> {
@@ -10,6 +13,15 @@ namespace dsp::routing {
 
         Splitter(stream<T>* in) { base_type::init(in); }
 
+        ~Splitter() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (auto& buf : pool) {
+                if (buf) { freeBuffer(buf); }
+            }
+            for (auto& buf : retired) { freeBuffer(buf); }
+        }
+
         void bindStream(stream<T>* stream) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -43,10 +55,53 @@ namespace dsp::routing {
             base_type::tempStart();
         }
 
+        // In shared mode the input is copied once into a pool buffer that is handed to every stream, instead of
+        // being copied into each of them. Only use it when none of the readers modify their input buffer in place.
+        void setSharedBuffers(bool enabled) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            shared = enabled;
+            for (auto& buf : pool) {
+                if (shared && !buf) { buf = new SharedBuffer; }
+            }
+            base_type::tempStart();
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            if (shared) {
+                // Free the buffers retired at the last stop once their readers let go of them
+                if (!retired.empty()) { freeRetired(); }
+
+                // Wait for the readers to be done with the oldest buffer of the pool
+                SharedBuffer& buf = *pool[next];
+                next = (next + 1) % SPLITTER_SHARED_POOL_SIZE;
+                if (!buf.refs.wait()) {
+                    base_type::_in->flush();
+                    return -1;
+                }
+
+                // Release the input right away so that the writer can go on while the readers work on the copy
+                if (count > buf.size) {
+                    if (buf.data) { buffer::free(buf.data); }
+                    buf.data = buffer::alloc<T>(count);
+                    buf.size = count;
+                }
+                memcpy(buf.data, base_type::_in->readBuf, count * sizeof(T));
+                base_type::_in->flush();
+
+                // Hand it out to every stream, it's reused once the last reader has flushed it
+                uint64_t round = buf.refs.begin();
+                for (const auto& stream : streams) {
+                    buf.refs.add();
+                    if (!stream->swapShared(buf.data, count, &buf.refs, round)) { return -1; }
+                }
+                return count;
+            }
+
             for (const auto& stream : streams) {
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
                 if (!stream->swap(count)) {
@@ -61,7 +116,48 @@ namespace dsp::routing {
         }
 
     protected:
+        void doStop() {
+            for (auto& buf : pool) {
+                if (buf) { buf->refs.stop(); }
+            }
+            base_type::doStop();
+
+            // A buffer still held by a reader can't be written again, it may even never be released if its stream
+            // was unbound. It's retired and replaced by a new one, and freed once the reader flushes it.
+            for (auto& buf : pool) {
+                if (!buf) { continue; }
+                buf->refs.clearStop();
+                if (buf->refs.released()) { continue; }
+                retired.push_back(buf);
+                buf = new SharedBuffer;
+            }
+            freeRetired();
+        }
+
+        void freeRetired() {
+            retired.erase(std::remove_if(retired.begin(), retired.end(), [](SharedBuffer* buf) {
+                if (!buf->refs.released()) { return false; }
+                freeBuffer(buf);
+                return true;
+            }), retired.end());
+        }
+
+        struct SharedBuffer {
+            T* data = NULL;
+            int size = 0;
+            buffer::RefCount refs;
+        };
+
+        static void freeBuffer(SharedBuffer* buf) {
+            if (buf->data) { buffer::free(buf->data); }
+            delete buf;
+        }
+
         std::vector<stream<T>*> streams;
+        SharedBuffer* pool[SPLITTER_SHARED_POOL_SIZE] = {};
+        std::vector<SharedBuffer*> retired;
+        int next = 0;
+        bool shared = false;
 
     };
 }
\ No newline at end of file
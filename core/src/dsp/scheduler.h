@@ -0,0 +1,327 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+// Spare workers kept parked for the next blocking task instead of exiting, any above that leave
+#define SCHEDULER_MAX_PARKED_SPARES 16
+
+namespace dsp::scheduler {
+    class Pool;
+
+    // Unit of work of the pool. A task is queued when notified while idle and ready, and is never queued or run twice at once.
+    class Task {
+    public:
+        virtual ~Task() {}
+
+        // True if the task can run without blocking
+        virtual bool ready() = 0;
+
+        // Run once, returns false if the task was stopped
+        virtual bool execute() = 0;
+
+        void activate() {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            active = true;
+        }
+
+        // Prevent any further scheduling, the task may still be queued or running afterwards
+        void deactivate() {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            active = false;
+        }
+
+        void waitIdle() {
+            std::unique_lock<std::mutex> lck(taskMtx);
+            idleCV.wait(lck, [this]() { return state == STATE_IDLE; });
+        }
+
+        // Called whenever something the task waits on changed
+        inline void notify();
+
+        // Called by the pool's workers
+        inline void runQueued();
+
+    private:
+        enum State {
+            STATE_IDLE,
+            STATE_QUEUED,
+            STATE_RUNNING
+        };
+
+        std::mutex taskMtx;
+        std::condition_variable idleCV;
+        State state = STATE_IDLE;
+        bool active = false;
+    };
+
+    // Fixed set of workers with a task deque each. A worker pushes the tasks it makes ready to its own deque and
+    // runs them right away (most recent first, the data is still in its cache), idle workers steal the oldest ones.
+    // When a worker blocks inside a task (see Blocking), a spare worker is woken up or started so that the number of
+    // workers able to make progress never drops below the configured count. Spares park once they aren't needed.
+    class Pool {
+    public:
+        Pool(int threadCount) {
+            target = std::max<int>(threadCount, 1);
+            unblocked = target;
+            for (int i = 0; i < target; i++) { workers.push_back(new Worker); }
+            for (int i = 0; i < target; i++) {
+                std::thread(&Pool::worker, this, workers[i]).detach();
+            }
+        }
+
+        void push(Task* task) {
+            Worker* w = currentWorker();
+            if (w && w->pool == this && w->owned) {
+                std::lock_guard<std::mutex> lck(w->mtx);
+                w->tasks.push_back(task);
+            }
+            else {
+                std::lock_guard<std::mutex> lck(injectMtx);
+                inject.push_back(task);
+            }
+            queued.fetch_add(1, std::memory_order_seq_cst);
+
+            // Only wake up a worker if one is sleeping
+            if (idle.load(std::memory_order_seq_cst) > 0) {
+                { std::lock_guard<std::mutex> lck(sleepMtx); }
+                sleepCV.notify_one();
+            }
+        }
+
+        void beginBlocking() {
+            // Keep enough workers that aren't blocked, unless some are idle and can take over
+            if (unblocked.fetch_sub(1) - 1 < target && idle.load() == 0) {
+                unblocked++;
+                startSpare();
+            }
+        }
+
+        void endBlocking() {
+            unblocked++;
+        }
+
+        int getThreadCount() { return target; }
+
+        struct Worker {
+            Pool* pool = NULL;
+            bool owned = false;
+            std::mutex mtx;
+            std::deque<Task*> tasks;
+        };
+
+        static Worker*& currentWorker() {
+            static thread_local Worker* worker = NULL;
+            return worker;
+        }
+
+    private:
+        void worker(Worker* own) {
+            // Spare workers have no deque of their own, the dummy one only tells which pool the thread belongs to
+            Worker spare;
+            spare.pool = this;
+            if (own) {
+                own->pool = this;
+                own->owned = true;
+            }
+            currentWorker() = own ? own : &spare;
+
+            while (true) {
+                Task* task = pop(own);
+                if (task) {
+                    task->runQueued();
+                }
+
+                // Spare workers park once there are enough unblocked workers again
+                if (!own && retireSpare()) {
+                    if (!parkSpare()) { return; }
+                    continue;
+                }
+                if (task) { continue; }
+
+                // Sleep until a task is queued
+                std::unique_lock<std::mutex> lck(sleepMtx);
+                idle.fetch_add(1, std::memory_order_seq_cst);
+                sleepCV.wait(lck, [this]() { return queued.load(std::memory_order_seq_cst) > 0; });
+                idle.fetch_sub(1, std::memory_order_seq_cst);
+            }
+        }
+
+        void startSpare() {
+            // Reuse a parked spare if one isn't already being woken up
+            {
+                std::lock_guard<std::mutex> lck(spareMtx);
+                if (parkedSpares > spareWakeups) {
+                    spareWakeups++;
+                    spareCV.notify_one();
+                    return;
+                }
+            }
+            std::thread(&Pool::worker, this, (Worker*)NULL).detach();
+        }
+
+        // Takes the spare out of the unblocked count if there are more than needed. Done in a single compare and
+        // swap so that two spares checking at once can't both leave and drop the count below the target.
+        bool retireSpare() {
+            int count = unblocked.load();
+            while (count > target) {
+                if (unblocked.compare_exchange_weak(count, count - 1)) { return true; }
+            }
+            return false;
+        }
+
+        // Waits until startSpare() needs the thread again, returns false if it should exit instead
+        bool parkSpare() {
+            std::unique_lock<std::mutex> lck(spareMtx);
+            if (parkedSpares >= SCHEDULER_MAX_PARKED_SPARES) { return false; }
+            parkedSpares++;
+            spareCV.wait(lck, [this]() { return spareWakeups > 0; });
+            spareWakeups--;
+            parkedSpares--;
+            return true;
+        }
+
+        Task* pop(Worker* own) {
+            Task* task = NULL;
+
+            // Newest task of our own deque first
+            if (own) {
+                std::lock_guard<std::mutex> lck(own->mtx);
+                if (!own->tasks.empty()) {
+                    task = own->tasks.back();
+                    own->tasks.pop_back();
+                }
+            }
+
+            // Then tasks queued from outside the pool
+            if (!task) {
+                std::lock_guard<std::mutex> lck(injectMtx);
+                if (!inject.empty()) {
+                    task = inject.front();
+                    inject.pop_front();
+                }
+            }
+
+            // Then steal the oldest task of another worker
+            for (int i = 0; !task && i < target; i++) {
+                Worker* w = workers[i];
+                if (w == own) { continue; }
+                std::lock_guard<std::mutex> lck(w->mtx);
+                if (!w->tasks.empty()) {
+                    task = w->tasks.front();
+                    w->tasks.pop_front();
+                }
+            }
+
+            if (task) { queued.fetch_sub(1, std::memory_order_seq_cst); }
+            return task;
+        }
+
+        int target;
+        std::vector<Worker*> workers;
+
+        std::mutex injectMtx;
+        std::deque<Task*> inject;
+
+        std::atomic<int> queued = 0;
+        std::atomic<int> idle = 0;
+        std::atomic<int> unblocked;
+
+        std::mutex sleepMtx;
+        std::condition_variable sleepCV;
+
+        std::mutex spareMtx;
+        std::condition_variable spareCV;
+        int parkedSpares = 0;
+        int spareWakeups = 0;
+    };
+
+    inline std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag = false;
+        return flag;
+    }
+
+    inline std::atomic<int>& threadCountSetting() {
+        static std::atomic<int> count = 0;
+        return count;
+    }
+
+    // Only affects blocks started after the call
+    inline void setEnabled(bool enabled) {
+        enabledFlag() = enabled;
+    }
+
+    inline bool isEnabled() {
+        return enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    // Number of workers, 0 for one per core. Must be called before the pool is first used.
+    inline void setThreadCount(int count) {
+        threadCountSetting() = count;
+    }
+
+    // The pool is never destroyed, its workers are detached and may still be running at exit
+    inline Pool& pool() {
+        static Pool* p = new Pool(threadCountSetting() > 0 ? threadCountSetting().load() : std::thread::hardware_concurrency());
+        return *p;
+    }
+
+    // Marks a region where the current thread may block waiting on another task. Does nothing outside of the pool.
+    class Blocking {
+    public:
+        Blocking() {
+            Pool::Worker* w = Pool::currentWorker();
+            p = w ? w->pool : NULL;
+            if (p) { p->beginBlocking(); }
+        }
+
+        ~Blocking() {
+            if (p) { p->endBlocking(); }
+        }
+
+    private:
+        Pool* p;
+    };
+
+    inline void Task::notify() {
+        {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            if (!active || state != STATE_IDLE) { return; }
+        }
+        if (!ready()) { return; }
+        {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            if (!active || state != STATE_IDLE) { return; }
+            state = STATE_QUEUED;
+        }
+        pool().push(this);
+    }
+
+    inline void Task::runQueued() {
+        {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            if (!active) {
+                state = STATE_IDLE;
+                idleCV.notify_all();
+                return;
+            }
+            state = STATE_RUNNING;
+        }
+
+        bool ok = execute();
+
+        {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            state = STATE_IDLE;
+            idleCV.notify_all();
+            if (!ok) { return; }
+        }
+
+        // Anything that became ready while running was not queued, check again
+        notify();
+    }
+}
@@ -32,12 +32,8 @@ namespace dsp::sink {
 
     private:
         void doStop() {
-            base_type::_in->stopReader();
             data.stopWriter();
-            if (base_type::workerThread.joinable()) {
-                base_type::workerThread.join();
-            }
-            base_type::_in->clearReadStop();
+            base_type::doStop();
             data.clearWriteStop();
         }
     };
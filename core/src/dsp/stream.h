@@ -2,8 +2,12 @@
 #include <string.h>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
+#include "buffer/ref_count.h"
+#include "profiler.h"
+#include "scheduler.h"
 
 // 1MSample buffer
 #define STREAM_BUFFER_SIZE 1000000
@@ -18,6 +22,40 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+
+        // Whether read() and swap() would return without waiting, used to schedule pooled blocks
+        virtual bool readable() { return true; }
+        virtual bool writable() { return true; }
+
+        // Tasks of the pooled blocks on each side of the stream, notified when the stream becomes readable or writable
+        void setReaderTask(scheduler::Task* task) {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            readerTask = task;
+        }
+
+        void setWriterTask(scheduler::Task* task) {
+            std::lock_guard<std::mutex> lck(taskMtx);
+            writerTask = task;
+        }
+
+    protected:
+        // The lock makes sure a task isn't notified anymore once its block has removed it
+        inline void notifyReader() {
+            if (!readerTask.load(std::memory_order_acquire)) { return; }
+            std::lock_guard<std::mutex> lck(taskMtx);
+            if (readerTask) { readerTask.load()->notify(); }
+        }
+
+        inline void notifyWriter() {
+            if (!writerTask.load(std::memory_order_acquire)) { return; }
+            std::lock_guard<std::mutex> lck(taskMtx);
+            if (writerTask) { writerTask.load()->notify(); }
+        }
+
+    private:
+        std::mutex taskMtx;
+        std::atomic<scheduler::Task*> readerTask = NULL;
+        std::atomic<scheduler::Task*> writerTask = NULL;
     };
 
     template <class T>
@@ -42,8 +80,12 @@ namespace dsp {
         virtual inline bool swap(int size) {
             {
                 // Wait to either swap or stop
+                profiler::WaitTimer timer(&profiler::BlockStats::swapWaitNs);
                 std::unique_lock<std::mutex> lck(swapMtx);
-                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                if (!canSwap && !writerStop) {
+                    scheduler::Blocking blocking;
+                    swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                }
 
                 // If writer was stopped, abandon operation
                 if (writerStop) { return false; }
@@ -55,6 +97,7 @@ namespace dsp {
                 readBuf = temp;
                 canSwap = false;
             }
+            profiler::countSwap(size);
 
             // Notify reader that some data is ready
             {
@@ -62,23 +105,65 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            notifyReader();
+
+            return true;
+        }
+
+        // Hand out a buffer owned by the writer instead of swapping, it stays valid until the reader flushes
+        virtual inline bool swapShared(T* data, int size, buffer::RefCount* refs, uint64_t round) {
+            {
+                // Wait to either swap or stop
+                profiler::WaitTimer timer(&profiler::BlockStats::swapWaitNs);
+                std::unique_lock<std::mutex> lck(swapMtx);
+                if (!canSwap && !writerStop) {
+                    scheduler::Blocking blocking;
+                    swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+                }
+
+                // If writer was stopped, abandon operation
+                if (writerStop) { return false; }
+                canSwap = false;
+            }
+            profiler::countSwap(size);
+
+            // Put the shared buffer in place of the read buffer and notify reader
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                dataSize = size;
+                ownReadBuf = readBuf;
+                readBuf = data;
+                sharedRefs = refs;
+                sharedRound = round;
+                dataReady = true;
+            }
+            rdyCV.notify_all();
+            notifyReader();
 
             return true;
         }
 
         virtual inline int read() {
             // Wait for data to be ready or to be stopped
+            profiler::WaitTimer timer(&profiler::BlockStats::readWaitNs);
             std::unique_lock<std::mutex> lck(rdyMtx);
-            rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+            bool ready = dataReady;
+            if (!dataReady && !readerStop) {
+                scheduler::Blocking blocking;
+                rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
+            }
 
-            return (readerStop ? -1 : dataSize);
+            if (readerStop) { return -1; }
+            profiler::countRead(ready, dataSize);
+            return dataSize;
         }
 
         virtual inline void flush() {
-            // Clear data ready
+            // Clear data ready and give back the shared buffer if one was handed out
             {
                 std::lock_guard<std::mutex> lck(rdyMtx);
                 dataReady = false;
+                releaseShared();
             }
 
             // Notify writer that buffers can be swapped
@@ -88,6 +173,17 @@ namespace dsp {
             }
 
             swapCV.notify_all();
+            notifyWriter();
+        }
+
+        virtual bool readable() {
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            return dataReady || readerStop;
+        }
+
+        virtual bool writable() {
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap || writerStop;
         }
 
         virtual void stopWriter() {
@@ -115,6 +211,11 @@ namespace dsp {
         }
 
         void free() {
+            // Never free a shared buffer, it belongs to its writer
+            if (sharedRefs) {
+                readBuf = ownReadBuf;
+                sharedRefs = NULL;
+            }
             if (writeBuf) { buffer::free(writeBuf); }
             if (readBuf) { buffer::free(readBuf); }
             writeBuf = NULL;
@@ -125,6 +226,13 @@ namespace dsp {
         T* readBuf;
 
     private:
+        inline void releaseShared() {
+            if (!sharedRefs) { return; }
+            readBuf = ownReadBuf;
+            sharedRefs->release(sharedRound);
+            sharedRefs = NULL;
+        }
+
         std::mutex swapMtx;
         std::condition_variable swapCV;
         bool canSwap = true;
@@ -137,5 +245,9 @@ namespace dsp {
         bool writerStop = false;
 
         int dataSize = 0;
+
+        T* ownReadBuf = NULL;
+        buffer::RefCount* sharedRefs = NULL;
+        uint64_t sharedRound = 0;
     };
 }
\ No newline at end of file
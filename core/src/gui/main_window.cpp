@@ -20,6 +20,8 @@
 #include <gui/menus/vfo_color.h>
 #include <gui/menus/module_manager.h>
 #include <gui/menus/theme.h>
+#include <gui/menus/profiler.h>
+#include <gui/menus/time_shift.h>
 #include <gui/dialogs/credits.h>
 #include <filesystem>
 #include <signal_path/source.h>
@@ -77,6 +79,8 @@ void MainWindow::init() {
     gui::menu.registerEntry("Theme", thememenu::draw, NULL);
     gui::menu.registerEntry("VFO Color", vfo_color_menu::draw, NULL);
     gui::menu.registerEntry("Module Manager", module_manager_menu::draw, NULL);
+    gui::menu.registerEntry("Profiler", profiler_menu::draw, NULL);
+    gui::menu.registerEntry("Time Shift", time_shift_menu::draw, NULL);
 
     gui::freqSelect.init();
 
@@ -169,6 +173,8 @@ void MainWindow::init() {
     displaymenu::init();
     vfo_color_menu::init();
     module_manager_menu::init();
+    profiler_menu::init();
+    time_shift_menu::init();
 
     // TODO for 0.2.5
     // Fix gain not updated on startup, soapysdr
@@ -227,6 +233,11 @@ void MainWindow::init() {
     core::moduleManager.doPostInitAll();
 }
 
+void MainWindow::deinit() {
+    // Wait for the menus' background work before the rest of the program goes away
+    time_shift_menu::deinit();
+}
+
 float* MainWindow::acquireFFTBuffer(void* ctx) {
     return gui::waterfall.getFFTBuffer();
 }
@@ -14,6 +14,7 @@
 class MainWindow {
 public:
     void init();
+    void deinit();
     void draw();
     void setViewBandwidthSlider(float bandwidth);
     bool sdrIsRunning();
@@ -0,0 +1,109 @@
+#include <gui/menus/profiler.h>
+#include <gui/gui.h>
+#include <dsp/profiler.h>
+#include <imgui.h>
+#include <map>
+#include <chrono>
+
+// Time between two updates of the displayed statistics
+#define PROFILER_MENU_UPDATE_PERIOD_MS  1000
+
+namespace profiler_menu {
+    struct BlockRates {
+        std::string name;
+        double inRate;
+        double outRate;
+        double duty;
+        double readWait;
+        double swapWait;
+        double ready;
+    };
+
+    bool enabled = false;
+    std::map<uint64_t, dsp::profiler::Snapshot> lastSnaps;
+    std::vector<BlockRates> rates;
+    std::chrono::steady_clock::time_point lastUpdate;
+
+    void init() {
+        enabled = dsp::profiler::isEnabled();
+    }
+
+    void update() {
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - lastUpdate).count();
+        lastUpdate = now;
+
+        // Compute the rates of each block from the difference with the last snapshot
+        std::map<uint64_t, dsp::profiler::Snapshot> snaps;
+        rates.clear();
+        for (auto& s : dsp::profiler::registry().snapshot()) {
+            snaps[s.id] = s;
+            auto it = lastSnaps.find(s.id);
+            if (it == lastSnaps.end()) { continue; }
+            auto& l = it->second;
+            double dtNs = dt * 1e9;
+            uint64_t reads = s.reads - l.reads;
+            BlockRates r;
+            r.name = s.name;
+            r.inRate = (double)(s.inSamples - l.inSamples) / dt;
+            r.outRate = (double)(s.outSamples - l.outSamples) / dt;
+            r.duty = 100.0 * (double)(s.busyNs - l.busyNs) / dtNs;
+            r.readWait = 100.0 * (double)(s.readWaitNs - l.readWaitNs) / dtNs;
+            r.swapWait = 100.0 * (double)(s.swapWaitNs - l.swapWaitNs) / dtNs;
+            r.ready = reads ? (100.0 * (double)(s.readyReads - l.readyReads) / (double)reads) : 0.0;
+            rates.push_back(r);
+        }
+        lastSnaps = snaps;
+
+        // Busiest blocks first
+        std::sort(rates.begin(), rates.end(), [](const BlockRates& a, const BlockRates& b) { return a.duty > b.duty; });
+    }
+
+    void draw(void* ctx) {
+        if (ImGui::Checkbox("Enabled##_profiler_enabled", &enabled)) {
+            dsp::profiler::setEnabled(enabled);
+            lastSnaps.clear();
+            rates.clear();
+        }
+        if (!enabled) { return; }
+
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count() >= PROFILER_MENU_UPDATE_PERIOD_MS) {
+            update();
+        }
+
+        // Duty is the time spent processing, waits are the time spent blocked on the input and output,
+        // ready is how often the input already had data waiting (a backlog builds up if close to 100%)
+        if (ImGui::BeginTable("Profiler Table", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable, ImVec2(0, 300))) {
+            ImGui::TableSetupColumn("Block");
+            ImGui::TableSetupColumn("In MS/s");
+            ImGui::TableSetupColumn("Out MS/s");
+            ImGui::TableSetupColumn("Duty");
+            ImGui::TableSetupColumn("Read Wait");
+            ImGui::TableSetupColumn("Swap Wait");
+            ImGui::TableSetupColumn("Ready");
+            ImGui::TableSetupScrollFreeze(1, 1);
+            ImGui::TableHeadersRow();
+
+            for (auto& r : rates) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(r.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.3f", r.inRate / 1e6);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", r.outRate / 1e6);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f%%", r.duty);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.1f%%", r.readWait);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%.1f%%", r.swapWait);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%.1f%%", r.ready);
+            }
+
+            ImGui::EndTable();
+        }
+    }
+}
@@ -14,6 +14,8 @@ namespace sourcemenu {
     int decimationPower = 0;
     bool iqCorrection = false;
     bool invertIQ = false;
+    bool channelizer = true;
+    bool workerPool = false;
 
     EventHandler<std::string> sourceRegisteredHandler;
     EventHandler<std::string> sourceUnregisterHandler;
@@ -147,6 +149,9 @@ namespace sourcemenu {
         invertIQ = core::configManager.conf["invertIQ"];
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
+        channelizer = core::configManager.conf["channelizer"];
+        sigpath::iqFrontEnd.setChannelizer(channelizer);
+        workerPool = core::configManager.conf["workerPool"];
         updateOffset();
 
         refreshSources();
@@ -195,6 +200,21 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
 
+        // Only applies to VFOs created after it's changed
+        if (ImGui::Checkbox("Shared Channelizer##_sdrpp_channelizer", &channelizer)) {
+            sigpath::iqFrontEnd.setChannelizer(channelizer);
+            core::configManager.acquire();
+            core::configManager.conf["channelizer"] = channelizer;
+            core::configManager.release(true);
+        }
+
+        // Blocks that are already running keep their thread, hence the restart
+        if (ImGui::Checkbox("Worker Pool (restart required)##_sdrpp_worker_pool", &workerPool)) {
+            core::configManager.acquire();
+            core::configManager.conf["workerPool"] = workerPool;
+            core::configManager.release(true);
+        }
+
         ImGui::LeftLabel("Offset mode");
         ImGui::SetNextItemWidth(itemWidth - ImGui::GetCursorPosX());
         if (ImGui::Combo("##_sdrpp_offset_mode", &offsetMode, offsetModesTxt)) {
@@ -0,0 +1,155 @@
+#include <gui/menus/time_shift.h>
+#include <gui/gui.h>
+#include <gui/style.h>
+#include <gui/widgets/folder_select.h>
+#include <signal_path/signal_path.h>
+#include <core.h>
+#include <imgui.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <time.h>
+
+// Name of the recording file inside the selected folder
+#define TIME_SHIFT_FILE_NAME    "timeshift.iq"
+
+namespace time_shift_menu {
+    bool enabled = false;
+    int duration = 60;
+    int exportDuration = 30;
+    FolderSelect folderSelect("%ROOT%/recordings");
+
+    std::thread exportThread;
+    std::atomic<bool> exporting = false;
+
+    // Written by the export thread, read by the UI
+    std::mutex exportStatusMtx;
+    std::string exportStatus = "";
+
+    void setExportStatus(const std::string& status) {
+        std::lock_guard<std::mutex> lck(exportStatusMtx);
+        exportStatus = status;
+    }
+
+    void applyRecording() {
+        std::string path = folderSelect.expandString(folderSelect.path + "/" TIME_SHIFT_FILE_NAME);
+        if (!sigpath::iqFrontEnd.getTimeShift()->setRecording(enabled, path, duration)) {
+            enabled = false;
+        }
+    }
+
+    void init() {
+        core::configManager.acquire();
+        enabled = core::configManager.conf["timeShift"]["enabled"];
+        duration = core::configManager.conf["timeShift"]["duration"];
+        exportDuration = core::configManager.conf["timeShift"]["exportDuration"];
+        folderSelect.setPath(core::configManager.conf["timeShift"]["path"]);
+        core::configManager.release();
+
+        if (enabled && folderSelect.pathIsValid()) { applyRecording(); }
+        else { enabled = false; }
+    }
+
+    void deinit() {
+        // An export still running would keep the thread joinable and terminate the program on exit
+        if (exportThread.joinable()) { exportThread.join(); }
+    }
+
+    void exportWorker(std::string path, double seconds) {
+        bool ok = sigpath::iqFrontEnd.getTimeShift()->exportWindow(path, seconds, seconds);
+        setExportStatus(ok ? ("Saved to " + path) : "Export failed");
+        exporting = false;
+    }
+
+    std::string formatTime(double seconds) {
+        char buf[64];
+        int s = seconds;
+        sprintf(buf, "%02d:%02d", s / 60, s % 60);
+        return buf;
+    }
+
+    void draw(void* ctx) {
+        float menuWidth = ImGui::GetContentRegionAvail().x;
+        auto ts = sigpath::iqFrontEnd.getTimeShift();
+
+        // The recording can't be reconfigured while it's in use
+        if (enabled || exporting) { style::beginDisabled(); }
+        ImGui::LeftLabel("Duration (s)");
+        ImGui::FillWidth();
+        if (ImGui::InputInt("##_time_shift_duration", &duration, 10, 60)) {
+            duration = std::max<int>(duration, 1);
+            core::configManager.acquire();
+            core::configManager.conf["timeShift"]["duration"] = duration;
+            core::configManager.release(true);
+        }
+        if (folderSelect.render("##_time_shift_folder")) {
+            if (folderSelect.pathIsValid()) {
+                core::configManager.acquire();
+                core::configManager.conf["timeShift"]["path"] = folderSelect.path;
+                core::configManager.release(true);
+            }
+        }
+        if (enabled || exporting) { style::endDisabled(); }
+
+        if (!folderSelect.pathIsValid() || exporting) { style::beginDisabled(); }
+        if (ImGui::Checkbox("Record##_time_shift_enabled", &enabled)) {
+            applyRecording();
+            core::configManager.acquire();
+            core::configManager.conf["timeShift"]["enabled"] = enabled;
+            core::configManager.release(true);
+        }
+        if (!folderSelect.pathIsValid() || exporting) { style::endDisabled(); }
+        if (!enabled) { return; }
+
+        // Position, in seconds behind live
+        double recorded = ts->getRecorded();
+        float delay = -ts->getDelay();
+        ImGui::LeftLabel("Position");
+        ImGui::FillWidth();
+        if (ImGui::SliderFloat("##_time_shift_pos", &delay, -recorded, 0.0f, ts->isLive() ? "Live" : "%.1f s")) {
+            ts->seek(-delay);
+        }
+
+        bool paused = ts->isPaused();
+        if (ImGui::Button(paused ? "Resume##_time_shift_pause" : "Pause##_time_shift_pause", ImVec2(menuWidth / 2.0f - 4.0f, 0))) {
+            if (paused) { ts->resume(); }
+            else { ts->pause(); }
+        }
+        ImGui::SameLine();
+        if (ts->isLive()) { style::beginDisabled(); }
+        if (ImGui::Button("Live##_time_shift_live", ImVec2(menuWidth - ImGui::GetCursorPosX(), 0))) {
+            ts->goLive();
+        }
+        if (ts->isLive()) { style::endDisabled(); }
+        ImGui::Text("Recorded: %s / %s", formatTime(recorded).c_str(), formatTime(duration).c_str());
+
+        // Save the end of the recording to a WAV file
+        if (exporting) { style::beginDisabled(); }
+        ImGui::LeftLabel("Export last (s)");
+        ImGui::FillWidth();
+        if (ImGui::InputInt("##_time_shift_export_dur", &exportDuration, 10, 60)) {
+            exportDuration = std::clamp<int>(exportDuration, 1, duration);
+            core::configManager.acquire();
+            core::configManager.conf["timeShift"]["exportDuration"] = exportDuration;
+            core::configManager.release(true);
+        }
+        if (ImGui::Button("Export##_time_shift_export", ImVec2(menuWidth, 0))) {
+            char buf[128];
+            time_t now = time(0);
+            tm* ltm = localtime(&now);
+            sprintf(buf, "/timeshift_%02d-%02d-%02d_%02d-%02d-%02d.wav", ltm->tm_mday, ltm->tm_mon + 1, ltm->tm_year + 1900, ltm->tm_hour, ltm->tm_min, ltm->tm_sec);
+            std::string path = folderSelect.expandString(folderSelect.path + buf);
+            if (exportThread.joinable()) { exportThread.join(); }
+            exporting = true;
+            setExportStatus("Exporting...");
+            exportThread = std::thread(exportWorker, path, (double)exportDuration);
+        }
+        if (exporting) { style::endDisabled(); }
+        std::string status;
+        {
+            std::lock_guard<std::mutex> lck(exportStatusMtx);
+            status = exportStatus;
+        }
+        if (!status.empty()) { ImGui::TextWrapped("%s", status.c_str()); }
+    }
+}
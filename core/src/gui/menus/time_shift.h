@@ -0,0 +1,7 @@
+#pragma once
+
+namespace time_shift_menu {
+    void init();
+    void deinit();
+    void draw(void* ctx);
+}
@@ -89,6 +89,28 @@ inline void doZoom(int offset, int width, int inSize, int outSize, float* in, fl
     }
 }
 
+// Lines are colored in blocks so that the index computation runs as one vectorizable loop before the lookups
+#define PALLET_BLOCK_SIZE   256
+
+inline void mapToPallet(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* pallet) {
+    int ids[PALLET_BLOCK_SIZE];
+    float scale = (float)(WATERFALL_RESOLUTION - 1) / (max - min);
+    float offset = -min * scale;
+    float top = (float)(WATERFALL_RESOLUTION - 1);
+    for (int i = 0; i < count; i += PALLET_BLOCK_SIZE) {
+        int n = std::min<int>(count - i, PALLET_BLOCK_SIZE);
+        for (int j = 0; j < n; j++) {
+            float id = (in[i + j] * scale) + offset;
+            id = (id > 0.0f) ? id : 0.0f;
+            id = (id < top) ? id : top;
+            ids[j] = (int)id;
+        }
+        for (int j = 0; j < n; j++) {
+            out[i + j] = pallet[ids[j]];
+        }
+    }
+}
+
 namespace ImGui {
     WaterFall::WaterFall() {
         fftMin = -70.0;
@@ -113,8 +135,18 @@ namespace ImGui {
         updatePallette(DEFAULT_COLOR_MAP, 13);
     }
 
+    WaterFall::~WaterFall() {
+        {
+            std::lock_guard<std::mutex> lck(recolorMtx);
+            stopRecolor = true;
+        }
+        recolorCV.notify_all();
+        if (recolorThread.joinable()) { recolorThread.join(); }
+    }
+
     void WaterFall::init() {
         glGenTextures(1, &textureId);
+        recolorThread = std::thread(&WaterFall::recolorWorker, this);
     }
 
     void WaterFall::drawFFT() {
@@ -210,9 +242,15 @@ namespace ImGui {
             waterfallUpdate = false;
             updateWaterfallTexture();
         }
-        {
+        if (waterfallHeight > 0) {
+            // The texture is a ring, draw from the newest line to the end then wrap around to the start
             std::lock_guard<std::mutex> lck(texMtx);
-            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, wfMax);
+            float split = (float)currentFFTLine / (float)waterfallHeight;
+            float splitY = wfMin.y + (waterfallHeight - currentFFTLine);
+            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, ImVec2(wfMax.x, splitY), ImVec2(0, split), ImVec2(1, 1));
+            if (currentFFTLine) {
+                window->DrawList->AddImage((void*)(intptr_t)textureId, ImVec2(wfMin.x, splitY), wfMax, ImVec2(0, 0), ImVec2(1, split));
+            }
         }
         
         ImVec2 mPos = ImGui::GetMousePos();
@@ -492,7 +530,7 @@ namespace ImGui {
                         ImGui::Text("Bandwidth Locked: %s", _vfo->bandwidthLocked ? "Yes" : "No");
 
                         float strength, snr;
-                        if (calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTSize] : rawFFTs, _vfo, strength, snr)) {
+                        if (calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTStride] : rawFFTs, _vfo, strength, snr)) {
                             ImGui::Text("Strength: %0.1fdBFS", strength);
                             ImGui::Text("SNR: %0.1fdB", snr);
                         }
@@ -598,36 +636,109 @@ namespace ImGui {
     }
 
     void WaterFall::updateWaterfallFb() {
-        if (!waterfallVisible || rawFFTs == NULL) {
-            return;
-        }
-        double offsetRatio = viewOffset / (wholeBandwidth / 2.0);
-        int drawDataSize;
-        int drawDataStart;
-        // TODO: Maybe put on the stack for faster alloc?
-        float* tempData = new float[dataWidth];
-        float pixel;
-        float dataRange = waterfallMax - waterfallMin;
-        int count = std::min<float>(waterfallHeight, fftLines);
-        if (rawFFTs != NULL && fftLines >= 0) {
-            for (int i = 0; i < count; i++) {
-                drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
-                drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
-                doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], tempData);
-                for (int j = 0; j < dataWidth; j++) {
-                    pixel = (std::clamp<float>(tempData[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                    waterfallFb[(i * dataWidth) + j] = waterfallPallet[(int)(pixel * (WATERFALL_RESOLUTION - 1))];
-                }
+        // Only request it, the colors are updated by the recolor thread starting from the newest line
+        {
+            std::lock_guard<std::mutex> lck(recolorMtx);
+            recolorGen++;
+        }
+        recolorCV.notify_all();
+    }
+
+    void WaterFall::recolorWorker() {
+        // Lines are done in small groups so that neither the DSP nor the UI wait on the whole history
+        const int groupSize = 16;
+        float* tempData = NULL;
+        int tempSize = 0;
+        uint64_t gen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(recolorMtx);
+                recolorCV.wait(lck, [&]() { return recolorGen != gen || stopRecolor; });
+                if (stopRecolor) { break; }
+                gen = recolorGen;
             }
 
-            for (int i = count; i < waterfallHeight; i++) {
-                for (int j = 0; j < dataWidth; j++) {
-                    waterfallFb[(i * dataWidth) + j] = (uint32_t)255 << 24;
+            // Lines are tracked by their position in the ring which stays valid when new FFTs are pushed in between groups
+            int line = -1;
+            int left = 0;
+            while (true) {
+                std::lock_guard<std::recursive_mutex> lck(buf_mtx);
+                {
+                    std::lock_guard<std::mutex> lck2(recolorMtx);
+                    if (recolorGen != gen || stopRecolor) { break; }
+                }
+                if (!waterfallVisible || rawFFTs == NULL || waterfallHeight <= 0) { break; }
+                if (line < 0) {
+                    line = currentFFTLine;
+                    left = waterfallHeight;
+                }
+                if (tempSize < dataWidth) {
+                    delete[] tempData;
+                    tempData = new float[dataWidth];
+                    tempSize = dataWidth;
+                }
+
+                double offsetRatio = viewOffset / (wholeBandwidth / 2.0);
+                int drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
+                int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
+                int count = std::min<int>(groupSize, left);
+                for (int i = 0; i < count; i++) {
+                    uint32_t* fbLine = &waterfallFb[line * dataWidth];
+                    int age = (line - currentFFTLine + waterfallHeight) % waterfallHeight;
+                    if (age < fftLines) {
+                        zoomLine(&rawFFTs[line * rawFFTStride], drawDataStart, drawDataSize, tempData);
+                        mapToPallet(tempData, fbLine, dataWidth, waterfallMin, waterfallMax, waterfallPallet);
+                    }
+                    else {
+                        std::fill(fbLine, fbLine + dataWidth, (uint32_t)255 << 24);
+                    }
+                    line = (line + 1) % waterfallHeight;
                 }
+                left -= count;
+                texFullUpdate = true;
+                waterfallUpdate = true;
+                if (!left) { break; }
             }
         }
         delete[] tempData;
-        waterfallUpdate = true;
+    }
+
+    void WaterFall::updateLevels() {
+        // Halve the size until the lines get too short to be worth zooming into
+        levelOffsets.clear();
+        levelSizes.clear();
+        int offset = 0;
+        int size = rawFFTSize;
+        while (true) {
+            levelOffsets.push_back(offset);
+            levelSizes.push_back(size);
+            offset += size;
+            if (size < 2 * WATERFALL_MIN_LEVEL_SIZE) { break; }
+            size = (size + 1) / 2;
+        }
+        rawFFTStride = offset;
+    }
+
+    void WaterFall::buildLevels(float* line) {
+        for (int k = 1; k < levelOffsets.size(); k++) {
+            const float* in = &line[levelOffsets[k - 1]];
+            float* out = &line[levelOffsets[k]];
+            int inSize = levelSizes[k - 1];
+            int pairs = inSize / 2;
+            for (int i = 0; i < pairs; i++) {
+                out[i] = std::max<float>(in[2 * i], in[(2 * i) + 1]);
+            }
+            if (inSize & 1) { out[pairs] = in[inSize - 1]; }
+        }
+    }
+
+    void WaterFall::zoomLine(float* line, int offset, int width, float* out) {
+        // Use the coarsest level that still has at least one bin per pixel
+        int k = 0;
+        while (k + 1 < levelOffsets.size() && ((width >> (k + 1)) >= dataWidth)) { k++; }
+        int scaledOffset = (offset >= 0) ? (offset >> k) : 0;
+        int scaledWidth = std::max<int>(width >> k, 1);
+        doZoom(scaledOffset, scaledWidth, levelSizes[k], dataWidth, &line[levelOffsets[k]], out);
     }
 
     void WaterFall::drawBandPlan() {
@@ -704,10 +815,30 @@ namespace ImGui {
     void WaterFall::updateWaterfallTexture() {
         std::lock_guard<std::mutex> lck(texMtx);
         glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+
+        // Reallocate and upload everything when the size changed or the history was recolored
+        if (texFullUpdate || texWidth != dataWidth || texHeight != waterfallHeight) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+            texWidth = dataWidth;
+            texHeight = waterfallHeight;
+            texFullUpdate = false;
+            texPendingLines = 0;
+            return;
+        }
+
+        // Otherwise only upload the new lines, in two parts if they wrap around the end of the ring
+        int count = std::min<int>(texPendingLines, waterfallHeight);
+        int first = std::min<int>(count, waterfallHeight - currentFFTLine);
+        if (first > 0) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, currentFFTLine, dataWidth, first, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)&waterfallFb[currentFFTLine * dataWidth]);
+        }
+        if (count > first) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dataWidth, count - first, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+        }
+        texPendingLines = 0;
     }
 
     void WaterFall::onPositionChange() {
@@ -740,18 +871,18 @@ namespace ImGui {
             fftLines = std::min<int>(fftLines, waterfallHeight) - 1;
             if (rawFFTs != NULL) {
                 if (currentFFTLine != 0) {
-                    float* tempWF = new float[currentFFTLine * rawFFTSize];
+                    float* tempWF = new float[currentFFTLine * rawFFTStride];
                     int moveCount = lastWaterfallHeight - currentFFTLine;
-                    memcpy(tempWF, rawFFTs, currentFFTLine * rawFFTSize * sizeof(float));
-                    memmove(rawFFTs, &rawFFTs[currentFFTLine * rawFFTSize], moveCount * rawFFTSize * sizeof(float));
-                    memcpy(&rawFFTs[moveCount * rawFFTSize], tempWF, currentFFTLine * rawFFTSize * sizeof(float));
+                    memcpy(tempWF, rawFFTs, currentFFTLine * rawFFTStride * sizeof(float));
+                    memmove(rawFFTs, &rawFFTs[currentFFTLine * rawFFTStride], moveCount * rawFFTStride * sizeof(float));
+                    memcpy(&rawFFTs[moveCount * rawFFTStride], tempWF, currentFFTLine * rawFFTStride * sizeof(float));
                     delete[] tempWF;
                 }
                 currentFFTLine = 0;
-                rawFFTs = (float*)realloc(rawFFTs, waterfallHeight * rawFFTSize * sizeof(float));
+                rawFFTs = (float*)realloc(rawFFTs, waterfallHeight * rawFFTStride * sizeof(float));
             }
             else {
-                rawFFTs = (float*)malloc(waterfallHeight * rawFFTSize * sizeof(float));
+                rawFFTs = (float*)malloc(waterfallHeight * rawFFTStride * sizeof(float));
             }
             // ==============
         }
@@ -780,7 +911,8 @@ namespace ImGui {
         if (waterfallVisible) {
             delete[] waterfallFb;
             waterfallFb = new uint32_t[dataWidth * waterfallHeight];
-            memset(waterfallFb, 0, dataWidth * waterfallHeight * sizeof(uint32_t));
+            std::fill(waterfallFb, waterfallFb + (dataWidth * waterfallHeight), (uint32_t)255 << 24);
+            texFullUpdate = true;
         }
         for (int i = 0; i < dataWidth; i++) {
             latestFFT[i] = -1000.0f; // Hide everything
@@ -881,7 +1013,7 @@ namespace ImGui {
             fftLines++;
             currentFFTLine = ((currentFFTLine + waterfallHeight) % waterfallHeight);
             fftLines = std::min<float>(fftLines, waterfallHeight);
-            return &rawFFTs[currentFFTLine * rawFFTSize];
+            return &rawFFTs[currentFFTLine * rawFFTStride];
         }
         return rawFFTs;
     }
@@ -894,19 +1026,15 @@ namespace ImGui {
         int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
 
         if (waterfallVisible) {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
-            memmove(&waterfallFb[dataWidth], waterfallFb, dataWidth * (waterfallHeight - 1) * sizeof(uint32_t));
-            float pixel;
-            float dataRange = waterfallMax - waterfallMin;
-            for (int j = 0; j < dataWidth; j++) {
-                pixel = (std::clamp<float>(latestFFT[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                int id = (int)(pixel * (WATERFALL_RESOLUTION - 1));
-                waterfallFb[j] = waterfallPallet[id];
-            }
+            buildLevels(&rawFFTs[currentFFTLine * rawFFTStride]);
+            zoomLine(&rawFFTs[currentFFTLine * rawFFTStride], drawDataStart, drawDataSize, latestFFT);
+            mapToPallet(latestFFT, &waterfallFb[currentFFTLine * dataWidth], dataWidth, waterfallMin, waterfallMax, waterfallPallet);
+            texPendingLines++;
             waterfallUpdate = true;
         }
         else {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, rawFFTs, latestFFT);
+            buildLevels(rawFFTs);
+            zoomLine(rawFFTs, drawDataStart, drawDataSize, latestFFT);
             fftLines = 1;
         }
 
@@ -923,11 +1051,11 @@ namespace ImGui {
             float dummy;
             if (snrSmoothing) {
                 float newSNR = 0.0f;
-                calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTSize] : rawFFTs, vfos[selectedVFO], dummy, newSNR);
+                calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTStride] : rawFFTs, vfos[selectedVFO], dummy, newSNR);
                 selectedVFOSNR = (snrSmoothingBeta*selectedVFOSNR) + (snrSmoothingAlpha*newSNR);
             }
             else {
-                calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTSize] : rawFFTs, vfos[selectedVFO], dummy, selectedVFOSNR);
+                calculateVFOSignalInfo(waterfallVisible ? &rawFFTs[currentFFTLine * rawFFTStride] : rawFFTs, vfos[selectedVFO], dummy, selectedVFOSNR);
             }
         }
 
@@ -1134,15 +1262,16 @@ namespace ImGui {
     void WaterFall::setRawFFTSize(int size) {
         std::lock_guard<std::recursive_mutex> lck(buf_mtx);
         rawFFTSize = size;
+        updateLevels();
         int wfSize = std::max<int>(1, waterfallHeight);
         if (rawFFTs != NULL) {
-            rawFFTs = (float*)realloc(rawFFTs, rawFFTSize * wfSize * sizeof(float));
+            rawFFTs = (float*)realloc(rawFFTs, rawFFTStride * wfSize * sizeof(float));
         }
         else {
-            rawFFTs = (float*)malloc(rawFFTSize * wfSize * sizeof(float));
+            rawFFTs = (float*)malloc(rawFFTStride * wfSize * sizeof(float));
         }
         fftLines = 0;
-        memset(rawFFTs, 0, rawFFTSize * waterfallHeight * sizeof(float));
+        memset(rawFFTs, 0, rawFFTStride * waterfallHeight * sizeof(float));
         updateWaterfallFb();
     }
 
@@ -1388,7 +1517,7 @@ namespace ImGui {
         }
         waterfallVisible = true;
         onResize();
-        memset(rawFFTs, 0, waterfallHeight * rawFFTSize * sizeof(float));
+        memset(rawFFTs, 0, waterfallHeight * rawFFTStride * sizeof(float));
         updateWaterfallFb();
         buf_mtx.unlock();
     }
@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <gui/widgets/bandplan.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
@@ -8,7 +10,10 @@
 
 #include <utils/opengl_include_code.h>
 
-#define WATERFALL_RESOLUTION 1000000
+#define WATERFALL_RESOLUTION 16384
+
+// Smallest line size kept in the max-hold pyramid of each FFT line
+#define WATERFALL_MIN_LEVEL_SIZE 256
 
 namespace ImGui {
     class WaterfallVFO {
@@ -83,6 +88,7 @@ namespace ImGui {
     class WaterFall {
     public:
         WaterFall();
+        ~WaterFall();
 
         void init();
 
@@ -228,6 +234,10 @@ namespace ImGui {
         void onResize();
         void updateWaterfallFb();
         void updateWaterfallTexture();
+        void recolorWorker();
+        void updateLevels();
+        void buildLevels(float* line);
+        void zoomLine(float* line, int offset, int width, float* out);
         void updateAllVFOs(bool checkRedrawRequired = false);
         bool calculateVFOSignalInfo(float* fftLine, WaterfallVFO* vfo, float& strength, float& snr);
 
@@ -283,6 +293,9 @@ namespace ImGui {
 
         //std::vector<std::vector<float>> rawFFTs;
         int rawFFTSize;
+        int rawFFTStride = 0;                // Each line is the raw FFT followed by its max-hold decimations
+        std::vector<int> levelOffsets;       // Where each decimation level starts in a line, level 0 is the raw FFT
+        std::vector<int> levelSizes;
         float* rawFFTs = NULL;
         float* latestFFT = NULL;
         float* latestFFTHold = NULL;
@@ -290,8 +303,22 @@ namespace ImGui {
         int currentFFTLine = 0;
         int fftLines = 0;
 
+        // Ring of colored lines, line i holds the colors of rawFFTs line i so the newest one is at currentFFTLine
         uint32_t* waterfallFb;
 
+        // Texture state, only the lines pushed since the last upload are sent unless a full upload is needed
+        int texWidth = 0;
+        int texHeight = 0;
+        int texPendingLines = 0;
+        bool texFullUpdate = true;
+
+        // Background recoloring of the history after a change of zoom, range or pallet
+        std::thread recolorThread;
+        std::mutex recolorMtx;
+        std::condition_variable recolorCV;
+        uint64_t recolorGen = 0;
+        bool stopRecolor = false;
+
         bool draggingFW = false;
         int FFTAreaHeight;
         int newFFTAreaHeight;
@@ -4,77 +4,263 @@
 #include <version.h>
 #include <config.h>
 #include <filesystem>
+#include <deque>
+#include <map>
 #include <dsp/types.h>
 #include <signal_path/signal_path.h>
 #include <gui/smgui.h>
 #include <utils/optionlist.h>
 #include "dsp/compression/sample_stream_compressor.h"
+#include "dsp/compression/zstd_chunked.h"
 #include "dsp/sink/handler_sink.h"
+#include "dsp/profiler.h"
+#include "dsp/channel/rx_vfo.h"
 #include <zstd.h>
 
+// Maximum number of clients connected at once
+#define SERVER_MAX_CLIENTS          16
+
+// Maximum number of baseband packets waiting to be sent to a client, about 160ms with the usual 200 buffers per second
+#define SERVER_CLIENT_QUEUE_SIZE    32
+
+// Period at which the stream statistics are sent to the clients and the adaptive format is updated
+#define SERVER_ADAPT_PERIOD_MS      1000
+
+// Number of periods without congestion before trying a less compressed format, doubled each time it fails
+#define SERVER_ADAPT_MIN_CALM       5
+#define SERVER_ADAPT_MAX_CALM       60
+
+// Size of the independently compressed chunks, small enough to split a buffer between all cores
+#define SERVER_COMPRESSION_CHUNK_SIZE   (64 * 1024)
+
+// Maximum number of server-side VFOs per client
+#define SERVER_MAX_CLIENT_VFOS      8
+
+// Maximum number of baseband buffers waiting for a client's server-side channels
+#define SERVER_CHANNEL_QUEUE_SIZE   8
+
 namespace server {
+    typedef std::shared_ptr<std::vector<uint8_t>> Packet;
+    typedef std::shared_ptr<std::vector<dsp::complex_t>> Samples;
+
+    // Narrowband channel extracted from the baseband for a single client
+    struct RemoteVFO {
+        RemoteVFO(const VFOConfig& config, double inSamplerate) {
+            this->config = config;
+            vfo.init(NULL, inSamplerate, config.sampleRate, config.bandwidth, config.offset);
+            buf = dsp::buffer::alloc<dsp::complex_t>(STREAM_BUFFER_SIZE);
+        }
+
+        ~RemoteVFO() {
+            dsp::buffer::free(buf);
+        }
+
+        void configure(const VFOConfig& config) {
+            if (config.sampleRate != this->config.sampleRate) {
+                vfo.setOutSamplerate(config.sampleRate, config.bandwidth);
+            }
+            else if (config.bandwidth != this->config.bandwidth) {
+                vfo.setBandwidth(config.bandwidth);
+            }
+            if (config.offset != this->config.offset) { vfo.setOffset(config.offset); }
+            this->config = config;
+        }
+
+        VFOConfig config;
+        dsp::channel::RxVFO vfo;
+        dsp::complex_t* buf;
+    };
+
+    // Baseband buffer for the server-side channels of a client, with the stream format at the time it was received
+    struct ChannelInput {
+        Samples samples;
+        dsp::compression::PCMType pcmType;
+        int compressionLevel;
+    };
+
+    struct ClientSession;
+    void channelWorker(ClientSession* cl);
+
+    struct ClientSession {
+        ClientSession(net::Conn conn, int id) {
+            this->conn = std::move(conn);
+            this->id = id;
+            rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+            sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+            s_pkt_hdr = (PacketHeader*)sbuf;
+            s_pkt_data = &sbuf[sizeof(PacketHeader)];
+            s_cmd_hdr = (CommandHeader*)s_pkt_data;
+            s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+            sendThread = std::thread(&ClientSession::sendWorker, this);
+            channelThread = std::thread(channelWorker, this);
+        }
+
+        ~ClientSession() {
+            {
+                std::lock_guard<std::mutex> lck(channelQueueMtx);
+                stopChannels = true;
+            }
+            channelQueueCV.notify_all();
+            if (channelThread.joinable()) { channelThread.join(); }
+
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                stopSender = true;
+            }
+            queueCV.notify_all();
+            conn->close();
+            if (sendThread.joinable()) { sendThread.join(); }
+            delete[] rbuf;
+            delete[] sbuf;
+        }
+
+        // Never blocks on the network. Control packets bypass the size limit so they can't be dropped.
+        void enqueue(const Packet& pkt, bool control = false) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!control && queue.size() >= SERVER_CLIENT_QUEUE_SIZE) {
+                    if (!dropped++) { flog::warn("Client #{0} can't keep up, dropping samples", id); }
+                    if (dropPolicy == DROP_POLICY_NEWEST) { return; }
+                    if (dropPolicy == DROP_POLICY_DISCONNECT) {
+                        kick = true;
+                        return;
+                    }
+                    queue.pop_front();
+                }
+                queue.push_back(pkt);
+            }
+            queueCV.notify_one();
+        }
+
+        // Never blocks the baseband thread, the oldest buffer is dropped if the channels can't keep up
+        void pushChannelInput(const ChannelInput& input) {
+            {
+                std::lock_guard<std::mutex> lck(channelQueueMtx);
+                if (channelQueue.size() >= SERVER_CHANNEL_QUEUE_SIZE) {
+                    if (!channelDropped++) { flog::warn("Server-side channels of client #{0} can't keep up, dropping samples", id); }
+                    channelQueue.pop_front();
+                }
+                channelQueue.push_back(input);
+            }
+            channelQueueCV.notify_one();
+        }
+
+        void sendWorker() {
+            while (true) {
+                Packet pkt;
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCV.wait(lck, [this]() { return !queue.empty() || stopSender; });
+                    if (stopSender) { return; }
+                    pkt = queue.front();
+                    queue.pop_front();
+                }
+                // Time spent writing tells how close to saturation the link is
+                auto start = std::chrono::steady_clock::now();
+                if (!conn->write(pkt->size(), pkt->data())) { return; }
+                writeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                bytesSent += pkt->size();
+            }
+        }
+
+        net::Conn conn;
+        int id;
+
+        uint8_t* rbuf;
+        uint8_t* sbuf;
+        PacketHeader* s_pkt_hdr;
+        uint8_t* s_pkt_data;
+        CommandHeader* s_cmd_hdr;
+        uint8_t* s_cmd_data;
+
+        // Protects the send buffer, commands can be sent from several threads
+        std::mutex sendMtx;
+
+        // Stream settings, only changed while holding clientsMtx
+        bool streaming = false;
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+        int compressionLevel = 0;
+        DropPolicy dropPolicy = DROP_POLICY_OLDEST;
+
+        // Server-side channels, run by channelWorker() on a thread of their own so that one client's DSP doesn't
+        // hold back the baseband of every other client. Only changed while holding channelMtx.
+        std::mutex channelMtx;
+        std::map<uint8_t, std::unique_ptr<RemoteVFO>> vfos;
+        std::atomic<bool> hasChannels = false;
+
+        std::mutex channelQueueMtx;
+        std::condition_variable channelQueueCV;
+        std::deque<ChannelInput> channelQueue;
+        bool stopChannels = false;
+        uint64_t channelDropped = 0;
+        std::thread channelThread;
+
+        // Automatic format selection, see adaptStream()
+        bool adaptive = false;
+        int adaptiveStep = 0;
+        int calmPeriods = 0;
+        int calmNeeded = SERVER_ADAPT_MIN_CALM;
+        uint64_t lastBytesSent = 0;
+        uint64_t lastWriteNs = 0;
+        uint64_t lastDropped = 0;
+
+        std::atomic<uint64_t> bytesSent = 0;
+        std::atomic<uint64_t> writeNs = 0;
+
+        std::mutex queueMtx;
+        std::condition_variable queueCV;
+        std::deque<Packet> queue;
+        bool stopSender = false;
+        uint64_t dropped = 0;
+        std::atomic<bool> kick = false;
+        std::thread sendThread;
+    };
+
+    // Formats the adaptive mode steps through, from the most accurate to the smallest
+    struct StreamFormat {
+        dsp::compression::PCMType pcmType;
+        int compressionLevel;
+    };
+    const StreamFormat adaptiveFormats[] = {
+        { dsp::compression::PCM_TYPE_F32, 0 },
+        { dsp::compression::PCM_TYPE_I16, 0 },
+        { dsp::compression::PCM_TYPE_I16, 1 },
+        { dsp::compression::PCM_TYPE_I8, 1 },
+        { dsp::compression::PCM_TYPE_I8, 3 }
+    };
+    const int adaptiveFormatCount = sizeof(adaptiveFormats) / sizeof(StreamFormat);
+
     dsp::stream<dsp::complex_t> dummyInput;
-    dsp::compression::SampleStreamCompressor comp;
-    dsp::sink::Handler<uint8_t> hnd;
-    net::Conn client;
-    uint8_t* rbuf = NULL;
-    uint8_t* sbuf = NULL;
-    uint8_t* bbuf = NULL;
-
-    PacketHeader* r_pkt_hdr = NULL;
-    uint8_t* r_pkt_data = NULL;
-    CommandHeader* r_cmd_hdr = NULL;
-    uint8_t* r_cmd_data = NULL;
-
-    PacketHeader* s_pkt_hdr = NULL;
-    uint8_t* s_pkt_data = NULL;
-    CommandHeader* s_cmd_hdr = NULL;
-    uint8_t* s_cmd_data = NULL;
-
-    PacketHeader* bb_pkt_hdr = NULL;
-    uint8_t* bb_pkt_data = NULL;
+    dsp::sink::Handler<dsp::complex_t> hnd;
+    uint8_t* pcmBuf = NULL;
+
+    std::mutex clientsMtx;
+    std::vector<std::unique_ptr<ClientSession>> clients;
+    int nextClientId = 0;
+
+    // Serializes commands and source control between clients
+    std::mutex cmdMtx;
 
     SmGui::DrawListElem dummyElem;
 
-    ZSTD_CCtx* cctx;
+    dsp::compression::ChunkedCompressor* compressor = NULL;
 
     net::Listener listener;
 
     OptionList<std::string, std::string> sourceList;
     int sourceId = 0;
     bool running = false;
-    bool compression = false;
     double sampleRate = 1000000.0;
 
     int main() {
         flog::info("=====| SERVER MODE |=====");
 
         // Init DSP
-        comp.init(&dummyInput, dsp::compression::PCM_TYPE_I8);
-        hnd.init(&comp.out, _testServerHandler, NULL);
-        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        comp.start();
+        hnd.init(&dummyInput, _basebandHandler, NULL);
+        pcmBuf = new uint8_t[STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8];
+        compressor = new dsp::compression::ChunkedCompressor(std::thread::hardware_concurrency(), SERVER_COMPRESSION_CHUNK_SIZE);
         hnd.start();
 
-        // Initialize headers
-        r_pkt_hdr = (PacketHeader*)rbuf;
-        r_pkt_data = &rbuf[sizeof(PacketHeader)];
-        r_cmd_hdr = (CommandHeader*)r_pkt_data;
-        r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        s_pkt_hdr = (PacketHeader*)sbuf;
-        s_pkt_data = &sbuf[sizeof(PacketHeader)];
-        s_cmd_hdr = (CommandHeader*)s_pkt_data;
-        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        bb_pkt_hdr = (PacketHeader*)bbuf;
-        bb_pkt_data = &bbuf[sizeof(PacketHeader)];
-
-        // Initialize compressor
-        cctx = ZSTD_createCCtx();
-
         // Load config
         core::configManager.acquire();
         std::string modulesDir = core::configManager.conf["modulesDirectory"];
@@ -155,15 +341,136 @@ namespace server {
         listener->acceptAsync(_clientHandler, NULL);
 
         flog::info("Ready, listening on {0}:{1}", host, port);
-        while(1) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+
+        // Clean up the clients that left and keep the stream formats in check
+        auto lastAdapt = std::chrono::steady_clock::now();
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            reapClients();
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - lastAdapt).count();
+            if (elapsed * 1000.0 < SERVER_ADAPT_PERIOD_MS) { continue; }
+            lastAdapt = now;
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            for (auto& cl : clients) { adaptStream(cl.get(), elapsed); }
+        }
 
         return 0;
     }
 
+    void reapClients() {
+        // Take them out of the list first, destroying a client waits for its network threads
+        std::vector<std::unique_ptr<ClientSession>> dead;
+        {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            for (auto it = clients.begin(); it != clients.end();) {
+                if ((*it)->conn->isOpen() && !(*it)->kick) {
+                    it++;
+                    continue;
+                }
+                dead.push_back(std::move(*it));
+                it = clients.erase(it);
+            }
+        }
+        if (dead.empty()) { return; }
+
+        for (auto& cl : dead) {
+            flog::info("Client #{0} disconnected ({1} buffers dropped)", cl->id, cl->dropped);
+        }
+        dead.clear();
+
+        std::lock_guard<std::mutex> lck(cmdMtx);
+        updateSource();
+    }
+
+    void updateSource() {
+        // Run the source as long as at least one client wants samples or has server-side channels
+        bool wanted = false;
+        {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            for (auto& cl : clients) { wanted |= (cl->streaming || cl->hasChannels); }
+        }
+        if (wanted && !running) {
+            sigpath::sourceManager.start();
+            running = true;
+        }
+        else if (!wanted && running) {
+            sigpath::sourceManager.stop();
+            running = false;
+        }
+    }
+
+    // Must be called with clientsMtx held
+    void adaptStream(ClientSession* cl, double elapsed) {
+        // Measure what happened since the last period
+        uint64_t bytesSent = cl->bytesSent;
+        uint64_t writeNs = cl->writeNs;
+        uint64_t dropped;
+        int queued;
+        {
+            std::lock_guard<std::mutex> lck(cl->queueMtx);
+            dropped = cl->dropped;
+            queued = cl->queue.size();
+        }
+        double sendRate = (double)(bytesSent - cl->lastBytesSent) / elapsed;
+        double linkBusy = (double)(writeNs - cl->lastWriteNs) / (elapsed * 1e9);
+        bool dropping = (dropped != cl->lastDropped);
+        cl->lastBytesSent = bytesSent;
+        cl->lastWriteNs = writeNs;
+        cl->lastDropped = dropped;
+
+        // The writes blocking most of the time or a growing queue means the link can't keep up, go one step smaller.
+        // Only go back up after the link stayed mostly idle for a while, and wait longer every time that failed.
+        if (cl->adaptive && (cl->streaming || cl->hasChannels)) {
+            int step = cl->adaptiveStep;
+            if (dropping || queued > SERVER_CLIENT_QUEUE_SIZE / 4 || linkBusy > 0.9) {
+                if (step < adaptiveFormatCount - 1) {
+                    step++;
+                    cl->calmNeeded = std::min<int>(cl->calmNeeded * 2, SERVER_ADAPT_MAX_CALM);
+                }
+                cl->calmPeriods = 0;
+            }
+            else if (linkBusy < 0.4 && queued <= 1 && step > 0 && ++cl->calmPeriods >= cl->calmNeeded) {
+                step--;
+                cl->calmPeriods = 0;
+            }
+            if (step != cl->adaptiveStep) {
+                cl->adaptiveStep = step;
+                cl->pcmType = adaptiveFormats[step].pcmType;
+                cl->compressionLevel = adaptiveFormats[step].compressionLevel;
+                flog::info("Client #{0} switched to sample type {1}, compression level {2} ({3} kB/s, link busy {4}%)", cl->id, (int)cl->pcmType, cl->compressionLevel, (int)(sendRate / 1e3), (int)(linkBusy * 100.0));
+            }
+        }
+
+        // Report the stream state to the client
+        Packet pkt = std::make_shared<std::vector<uint8_t>>(sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(StreamStatus));
+        PacketHeader* hdr = (PacketHeader*)pkt->data();
+        CommandHeader* chdr = (CommandHeader*)&(*pkt)[sizeof(PacketHeader)];
+        hdr->type = PACKET_TYPE_COMMAND;
+        hdr->size = pkt->size();
+        chdr->cmd = COMMAND_STREAM_STATUS;
+        StreamStatus status;
+        status.pcmType = cl->pcmType;
+        status.compressionLevel = cl->compressionLevel;
+        status.adaptive = cl->adaptive;
+        status.queued = queued;
+        status.dropped = dropped;
+        status.sendRate = sendRate;
+        status.linkBusy = linkBusy;
+        memcpy(&(*pkt)[sizeof(PacketHeader) + sizeof(CommandHeader)], &status, sizeof(StreamStatus));
+        cl->enqueue(pkt, true);
+    }
+
     void _clientHandler(net::Conn conn, void* ctx) {
-        // Reject if someone else is already connected
-        if (client && client->isOpen()) {
-            flog::info("REJECTED Connection from {0}:{1}, another client is already connected.", "TODO", "TODO");
+        // Reject if the server is full
+        int clientCount;
+        {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            clientCount = clients.size();
+        }
+        if (clientCount >= SERVER_MAX_CLIENTS) {
+            flog::info("REJECTED Connection, already {0} clients connected.", clientCount);
             
             // Issue a disconnect command to the client
             uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
@@ -184,31 +491,38 @@ namespace server {
             return;
         }
 
-        flog::info("Connection from {0}:{1}", "TODO", "TODO");
-        client = std::move(conn);
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
-
-        // Perform settings reset
-        sigpath::sourceManager.stop();
-        comp.setPCMType(dsp::compression::PCM_TYPE_I16);
-        compression = false;
-
-        sendSampleRate(sampleRate);
+        // Register the client, new clients don't get samples until they ask for them
+        ClientSession* cl;
+        {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            clients.push_back(std::make_unique<ClientSession>(std::move(conn), nextClientId++));
+            cl = clients.back().get();
+        }
+        flog::info("Client #{0} connected", cl->id);
+        cl->conn->readAsync(sizeof(PacketHeader), cl->rbuf, _packetHandler, cl);
 
-        // TODO: Wait otherwise someone else could connect
+        sendSampleRate(cl, sampleRate);
 
         listener->acceptAsync(_clientHandler, NULL);
     }
 
     void _packetHandler(int count, uint8_t* buf, void* ctx) {
+        ClientSession* cl = (ClientSession*)ctx;
         PacketHeader* hdr = (PacketHeader*)buf;
 
-        // Read the rest of the data (TODO: CHECK SIZE OR SHIT WILL BE FUCKED + ADD TIMEOUT)
+        // Drop clients sending packets that can't be valid
+        if (hdr->size < sizeof(PacketHeader) || hdr->size > SERVER_MAX_PACKET_SIZE) {
+            flog::error("Client #{0} sent an invalid packet size, disconnecting", cl->id);
+            cl->kick = true;
+            return;
+        }
+
+        // Read the rest of the data (TODO: ADD TIMEOUT)
         int len = 0;
         int read = 0;
         int goal = hdr->size - sizeof(PacketHeader);
         while (len < goal) {
-            read = client->read(goal - len, &buf[sizeof(PacketHeader) + len]);
+            read = cl->conn->read(goal - len, &buf[sizeof(PacketHeader) + len]);
             if (read < 0) { return; };
             len += read;
         }
@@ -216,39 +530,124 @@ namespace server {
         // Parse and process
         if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
             CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+            std::lock_guard<std::mutex> lck(cmdMtx);
+            commandHandler(cl, (Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
         }
         else {
-            sendError(ERROR_INVALID_PACKET);
+            sendError(cl, ERROR_INVALID_PACKET);
         }
 
         // Start another async read
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+        cl->conn->readAsync(sizeof(PacketHeader), cl->rbuf, _packetHandler, cl);
     }
 
-    void _testServerHandler(uint8_t* data, int count, void* ctx) {
-        // Compress data if needed and fill out header fields
-        if (compression) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
+    // Encode samples into a new packet, leaving headerSize bytes at the start for the caller to fill out.
+    // pcm must hold the encoded samples. Compression uses the shared chunked compressor unless a context is given.
+    Packet encodeSamples(const dsp::complex_t* data, int count, dsp::compression::PCMType pcmType, int compressionLevel, int headerSize, uint8_t* pcm, ZSTD_CCtx* cctx = NULL) {
+        int size = dsp::compression::SampleStreamCompressor::process(count, pcmType, data, pcm);
+
+        // Compress data if needed
+        Packet pkt = std::make_shared<std::vector<uint8_t>>();
+        if (compressionLevel > 0) {
+            pkt->resize(headerSize + (cctx ? ZSTD_compressBound(size) : compressor->bound(size)));
+            size_t csize;
+            if (cctx) {
+                csize = ZSTD_compressCCtx(cctx, &(*pkt)[headerSize], pkt->size() - headerSize, pcm, size, compressionLevel);
+            }
+            else {
+                csize = compressor->compress(&(*pkt)[headerSize], pkt->size() - headerSize, pcm, size, compressionLevel);
+            }
+            if (ZSTD_isError(csize)) { return NULL; }
+            pkt->resize(headerSize + csize);
         }
         else {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-            memcpy(&bbuf[sizeof(PacketHeader)], data, count);
+            pkt->resize(headerSize + size);
+            memcpy(&(*pkt)[headerSize], pcm, size);
+        }
+
+        PacketHeader* hdr = (PacketHeader*)pkt->data();
+        hdr->size = pkt->size();
+        return pkt;
+    }
+
+    Packet encodeBaseband(const dsp::complex_t* data, int count, dsp::compression::PCMType pcmType, int compressionLevel) {
+        Packet pkt = encodeSamples(data, count, pcmType, compressionLevel, sizeof(PacketHeader), pcmBuf);
+        if (!pkt) { return NULL; }
+        PacketHeader* hdr = (PacketHeader*)pkt->data();
+        hdr->type = (compressionLevel > 0) ? PACKET_TYPE_BASEBAND_COMPRESSED : PACKET_TYPE_BASEBAND;
+        return pkt;
+    }
+
+    // Must be called with the client's channelMtx held
+    void processVFOs(ClientSession* cl, const ChannelInput& input, uint8_t* pcm, ZSTD_CCtx* cctx) {
+        for (auto& [id, rvfo] : cl->vfos) {
+            int outCount = rvfo->vfo.process(input.samples->size(), input.samples->data(), rvfo->buf);
+            if (!outCount) { continue; }
+            Packet pkt = encodeSamples(rvfo->buf, outCount, input.pcmType, input.compressionLevel, sizeof(PacketHeader) + sizeof(VFOHeader), pcm, cctx);
+            if (!pkt) { continue; }
+            PacketHeader* hdr = (PacketHeader*)pkt->data();
+            VFOHeader* vhdr = (VFOHeader*)&(*pkt)[sizeof(PacketHeader)];
+            hdr->type = PACKET_TYPE_VFO;
+            vhdr->id = id;
+            vhdr->compressed = (input.compressionLevel > 0);
+            cl->enqueue(pkt);
+        }
+    }
+
+    void channelWorker(ClientSession* cl) {
+        // Own encoding buffer and compression context, the baseband ones belong to the baseband thread
+        std::vector<uint8_t> pcm;
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+
+        while (true) {
+            ChannelInput input;
+            {
+                std::unique_lock<std::mutex> lck(cl->channelQueueMtx);
+                cl->channelQueueCV.wait(lck, [cl]() { return !cl->channelQueue.empty() || cl->stopChannels; });
+                if (cl->stopChannels) { break; }
+                input = cl->channelQueue.front();
+                cl->channelQueue.pop_front();
+            }
+
+            if (pcm.empty()) { pcm.resize(STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8); }
+            std::lock_guard<std::mutex> lck(cl->channelMtx);
+            processVFOs(cl, input, pcm.data(), cctx);
         }
 
-        // Write to network
-        if (client && client->isOpen()) { client->write(bb_pkt_hdr->size, bbuf); }
+        ZSTD_freeCCtx(cctx);
+    }
+
+    void _basebandHandler(dsp::complex_t* data, int count, void* ctx) {
+        std::lock_guard<std::mutex> lck(clientsMtx);
+
+        // Encode the baseband once per distinct format and hand the same packet to every client using it
+        std::map<std::pair<int, int>, Packet> packets;
+        for (auto& cl : clients) {
+            if (!cl->streaming || cl->kick) { continue; }
+            auto key = std::make_pair((int)cl->pcmType, cl->compressionLevel);
+            auto it = packets.find(key);
+            if (it == packets.end()) {
+                it = packets.emplace(key, encodeBaseband(data, count, cl->pcmType, cl->compressionLevel)).first;
+            }
+            if (it->second) { cl->enqueue(it->second); }
+        }
+
+        // Hand a copy to the clients with server-side channels, their DSP runs on each client's own thread
+        Samples samples;
+        for (auto& cl : clients) {
+            if (!cl->hasChannels || cl->kick) { continue; }
+            if (!samples) { samples = std::make_shared<std::vector<dsp::complex_t>>(data, data + count); }
+            cl->pushChannelInput({ samples, cl->pcmType, cl->compressionLevel });
+        }
     }
 
     void setInput(dsp::stream<dsp::complex_t>* stream) {
-        comp.setInput(stream);
+        hnd.setInput(stream);
     }
 
-    void commandHandler(Command cmd, uint8_t* data, int len) {
+    void commandHandler(ClientSession* cl, Command cmd, uint8_t* data, int len) {
         if (cmd == COMMAND_GET_UI) {
-            sendUI(COMMAND_GET_UI, "", dummyElem);
+            sendUI(cl, COMMAND_GET_UI, "", dummyElem);
         }
         else if (cmd == COMMAND_UI_ACTION && len >= 3) {
             // Check if sending back data is needed
@@ -259,48 +658,132 @@ namespace server {
             // Load id
             SmGui::DrawListElem diffId;
             int count = SmGui::DrawList::loadItem(diffId, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
-            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(ERROR_INVALID_ARGUMENT); return; } 
+            if (count < 0) { sendError(cl, ERROR_INVALID_ARGUMENT); return; }
+            if (diffId.type != SmGui::DRAW_LIST_ELEM_TYPE_STRING) { sendError(cl, ERROR_INVALID_ARGUMENT); return; } 
             i += count;
             len -= count;
 
             // Load value
             SmGui::DrawListElem diffValue;
             count = SmGui::DrawList::loadItem(diffValue, &data[i], len);
-            if (count < 0) { sendError(ERROR_INVALID_ARGUMENT); return; }
+            if (count < 0) { sendError(cl, ERROR_INVALID_ARGUMENT); return; }
             i += count;
             len -= count;
 
             // Render and send back
             if (sendback) {
-                sendUI(COMMAND_UI_ACTION, diffId.str, diffValue);
+                sendUI(cl, COMMAND_UI_ACTION, diffId.str, diffValue);
             }
             else {
                 renderUI(NULL, diffId.str, diffValue);
             }
         }
         else if (cmd == COMMAND_START) {
-            sigpath::sourceManager.start();
-            running = true;
+            {
+                std::lock_guard<std::mutex> lck(clientsMtx);
+                cl->streaming = true;
+            }
+            updateSource();
         }
         else if (cmd == COMMAND_STOP) {
-            sigpath::sourceManager.stop();
-            running = false;
+            {
+                std::lock_guard<std::mutex> lck(clientsMtx);
+                cl->streaming = false;
+            }
+            updateSource();
         }
         else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
             sigpath::sourceManager.tune(*(double*)data);
-            sendCommandAck(COMMAND_SET_FREQUENCY, 0);
+            std::lock_guard<std::mutex> lck(cl->sendMtx);
+            sendCommandAck(cl, COMMAND_SET_FREQUENCY, 0);
         }
         else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1) {
-            dsp::compression::PCMType type = (dsp::compression::PCMType)*(uint8_t*)data;
-            comp.setPCMType(type);
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            cl->pcmType = (dsp::compression::PCMType)*(uint8_t*)data;
+            cl->adaptive = false;
         }
         else if (cmd == COMMAND_SET_COMPRESSION && len == 1) {
-            compression = *(uint8_t*)data;
+            // Older clients send a boolean, which maps to level 1
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            cl->compressionLevel = std::min<int>(*(uint8_t*)data, ZSTD_maxCLevel());
+            cl->adaptive = false;
+        }
+        else if (cmd == COMMAND_SET_ADAPTIVE && len == 1) {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            cl->adaptive = data[0];
+            if (!cl->adaptive) { return; }
+
+            // Start from the format the client was using, or the closest one
+            cl->adaptiveStep = 2;
+            for (int i = 0; i < adaptiveFormatCount; i++) {
+                if (adaptiveFormats[i].pcmType == cl->pcmType && adaptiveFormats[i].compressionLevel == cl->compressionLevel) { cl->adaptiveStep = i; }
+            }
+            cl->pcmType = adaptiveFormats[cl->adaptiveStep].pcmType;
+            cl->compressionLevel = adaptiveFormats[cl->adaptiveStep].compressionLevel;
+            cl->calmPeriods = 0;
+            cl->calmNeeded = SERVER_ADAPT_MIN_CALM;
+        }
+        else if (cmd == COMMAND_SET_DROP_POLICY && len == 1 && data[0] <= DROP_POLICY_DISCONNECT) {
+            std::lock_guard<std::mutex> lck(clientsMtx);
+            cl->dropPolicy = (DropPolicy)data[0];
+        }
+        else if (cmd == COMMAND_SET_VFO && len == sizeof(VFOConfig)) {
+            VFOConfig config;
+            memcpy(&config, data, sizeof(VFOConfig));
+
+            // The VFO can only decimate and has to stay within the baseband
+            if (config.sampleRate <= 0 || config.sampleRate > sampleRate || config.bandwidth <= 0 || config.bandwidth > config.sampleRate || fabs(config.offset) > sampleRate / 2.0) {
+                sendError(cl, ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            bool full = false;
+            {
+                std::lock_guard<std::mutex> lck(cl->channelMtx);
+                auto it = cl->vfos.find(config.id);
+                if (it != cl->vfos.end()) {
+                    it->second->configure(config);
+                }
+                else if (cl->vfos.size() < SERVER_MAX_CLIENT_VFOS) {
+                    cl->vfos[config.id] = std::make_unique<RemoteVFO>(config, sampleRate);
+                }
+                else {
+                    full = true;
+                }
+                cl->hasChannels = !cl->vfos.empty();
+            }
+            if (full) {
+                sendError(cl, ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            updateSource();
+            std::lock_guard<std::mutex> lck(cl->sendMtx);
+            sendCommandAck(cl, COMMAND_SET_VFO, 0);
+        }
+        else if (cmd == COMMAND_REMOVE_VFO && len == 1) {
+            {
+                std::lock_guard<std::mutex> lck(cl->channelMtx);
+                cl->vfos.erase(data[0]);
+                cl->hasChannels = !cl->vfos.empty();
+            }
+            updateSource();
+        }
+        else if (cmd == COMMAND_SET_PROFILING && len == 1) {
+            dsp::profiler::setEnabled(*(uint8_t*)data);
+        }
+        else if (cmd == COMMAND_GET_PROFILE) {
+            // Reply with the raw counters of every profiled block, the client computes the rates
+            std::vector<uint8_t> profile = dsp::profiler::Registry::serialize(dsp::profiler::registry().snapshot());
+            if (profile.size() > SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader) - sizeof(CommandHeader)) {
+                sendError(cl, ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            std::lock_guard<std::mutex> lck(cl->sendMtx);
+            memcpy(cl->s_cmd_data, profile.data(), profile.size());
+            sendCommandAck(cl, COMMAND_GET_PROFILE, profile.size());
         }
         else {
             flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
-            sendError(ERROR_INVALID_COMMAND);
+            sendError(cl, ERROR_INVALID_COMMAND);
         }
     }
 
@@ -339,49 +822,83 @@ namespace server {
         }
     }
 
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
+    void sendUI(ClientSession* cl, Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
         // Render UI
         SmGui::DrawList dl;
         renderUI(&dl, diffId, diffValue);
 
         // Create response
+        std::lock_guard<std::mutex> lck(cl->sendMtx);
         int size = dl.getSize();
-        dl.store(s_cmd_data, size);
+        dl.store(cl->s_cmd_data, size);
 
         // Send to network
-        sendCommandAck(originCmd, size);
+        sendCommandAck(cl, originCmd, size);
     }
 
-    void sendError(Error err) {
-        PacketHeader* hdr = (PacketHeader*)sbuf;
-        s_pkt_data[0] = err;
-        sendPacket(PACKET_TYPE_ERROR, 1);
+    void sendError(ClientSession* cl, Error err) {
+        std::lock_guard<std::mutex> lck(cl->sendMtx);
+        cl->s_pkt_data[0] = err;
+        sendPacket(cl, PACKET_TYPE_ERROR, 1);
     }
 
-    void sendSampleRate(double sampleRate) {
-        *(double*)s_cmd_data = sampleRate;
-        sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
+    void sendSampleRate(ClientSession* cl, double sampleRate) {
+        std::lock_guard<std::mutex> lck(cl->sendMtx);
+        *(double*)cl->s_cmd_data = sampleRate;
+        sendCommand(cl, COMMAND_SET_SAMPLERATE, sizeof(double));
     }
 
     void setInputSampleRate(double samplerate) {
         sampleRate = samplerate;
-        if (!client || !client->isOpen()) { return; }
-        sendSampleRate(sampleRate);
+
+        // Queue the change behind the samples already waiting so that clients apply it at the right time
+        Packet pkt = std::make_shared<std::vector<uint8_t>>(sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(double));
+        PacketHeader* hdr = (PacketHeader*)pkt->data();
+        CommandHeader* chdr = (CommandHeader*)&(*pkt)[sizeof(PacketHeader)];
+        hdr->type = PACKET_TYPE_COMMAND;
+        hdr->size = pkt->size();
+        chdr->cmd = COMMAND_SET_SAMPLERATE;
+        memcpy(&(*pkt)[sizeof(PacketHeader) + sizeof(CommandHeader)], &samplerate, sizeof(double));
+
+        std::lock_guard<std::mutex> lck(clientsMtx);
+        for (auto& cl : clients) {
+            cl->enqueue(pkt, true);
+
+            // Buffers still waiting for the channels were captured at the old samplerate
+            {
+                std::lock_guard<std::mutex> qlck(cl->channelQueueMtx);
+                cl->channelQueue.clear();
+            }
+
+            // VFOs can't resample up, drop the ones that no longer fit
+            std::lock_guard<std::mutex> clck(cl->channelMtx);
+            for (auto it = cl->vfos.begin(); it != cl->vfos.end();) {
+                if (it->second->config.sampleRate > samplerate) {
+                    flog::warn("Removing VFO {0} of client #{1}, its samplerate is higher than the new input samplerate", it->first, cl->id);
+                    it = cl->vfos.erase(it);
+                    continue;
+                }
+                it->second->vfo.setInSamplerate(samplerate);
+                it++;
+            }
+            cl->hasChannels = !cl->vfos.empty();
+        }
     }
 
-    void sendPacket(PacketType type, int len) {
-        s_pkt_hdr->type = type;
-        s_pkt_hdr->size = sizeof(PacketHeader) + len;
-        client->write(s_pkt_hdr->size, sbuf);
+    // The caller must hold the client's sendMtx
+    void sendPacket(ClientSession* cl, PacketType type, int len) {
+        cl->s_pkt_hdr->type = type;
+        cl->s_pkt_hdr->size = sizeof(PacketHeader) + len;
+        cl->conn->write(cl->s_pkt_hdr->size, cl->sbuf);
     }
 
-    void sendCommand(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
+    void sendCommand(ClientSession* cl, Command cmd, int len) {
+        cl->s_cmd_hdr->cmd = cmd;
+        sendPacket(cl, PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
     }
 
-    void sendCommandAck(Command cmd, int len) {
-        s_cmd_hdr->cmd = cmd;
-        sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
+    void sendCommandAck(ClientSession* cl, Command cmd, int len) {
+        cl->s_cmd_hdr->cmd = cmd;
+        sendPacket(cl, PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
     }
 }
@@ -8,20 +8,26 @@ namespace server {
     void setInput(dsp::stream<dsp::complex_t>* stream);
     int main();
 
+    struct ClientSession;
+
     void _clientHandler(net::Conn conn, void* ctx);
     void _packetHandler(int count, uint8_t* buf, void* ctx);
-    void _testServerHandler(uint8_t* data, int count, void* ctx);
+    void _basebandHandler(dsp::complex_t* data, int count, void* ctx);
+
+    void reapClients();
+    void adaptStream(ClientSession* cl, double elapsed);
+    void updateSource();
 
     void drawMenu();
 
-    void commandHandler(Command cmd, uint8_t* data, int len);
+    void commandHandler(ClientSession* cl, Command cmd, uint8_t* data, int len);
     void renderUI(SmGui::DrawList* dl, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendError(Error err);
-    void sendSampleRate(double sampleRate);
+    void sendUI(ClientSession* cl, Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
+    void sendError(ClientSession* cl, Error err);
+    void sendSampleRate(ClientSession* cl, double sampleRate);
     void setInputSampleRate(double samplerate);
 
-    void sendPacket(PacketType type, int len);
-    void sendCommand(Command cmd, int len);
-    void sendCommandAck(Command cmd, int len);
+    void sendPacket(ClientSession* cl, PacketType type, int len);
+    void sendCommand(ClientSession* cl, Command cmd, int len);
+    void sendCommandAck(ClientSession* cl, Command cmd, int len);
 }
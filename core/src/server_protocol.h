@@ -27,10 +27,24 @@ namespace server {
         COMMAND_GET_SAMPLERATE,
         COMMAND_SET_SAMPLE_TYPE,
         COMMAND_SET_COMPRESSION,
+        COMMAND_SET_PROFILING,
+        COMMAND_GET_PROFILE,
+        COMMAND_SET_DROP_POLICY,
+        COMMAND_SET_VFO,
+        COMMAND_REMOVE_VFO,
+        COMMAND_SET_ADAPTIVE,
 
         // Server to client
         COMMAND_SET_SAMPLERATE = 0x80,
-        COMMAND_DISCONNECT
+        COMMAND_DISCONNECT,
+        COMMAND_STREAM_STATUS
+    };
+
+    // What the server does when a client can't keep up with the samples
+    enum DropPolicy {
+        DROP_POLICY_OLDEST,
+        DROP_POLICY_NEWEST,
+        DROP_POLICY_DISCONNECT
     };
 
     enum Error {
@@ -49,5 +63,30 @@ namespace server {
     struct CommandHeader {
         uint32_t cmd;
     };
+
+    // Argument of COMMAND_SET_VFO, creates the VFO if the id isn't used yet
+    struct VFOConfig {
+        uint8_t id;
+        double offset;
+        double bandwidth;
+        double sampleRate;
+    };
+
+    // Argument of COMMAND_STREAM_STATUS, sent periodically by the server
+    struct StreamStatus {
+        uint8_t pcmType;
+        uint8_t compressionLevel;
+        uint8_t adaptive;
+        uint32_t queued;
+        uint64_t dropped;
+        double sendRate;
+        double linkBusy;
+    };
+
+    // Start of a PACKET_TYPE_VFO payload, followed by the samples in the same format as the baseband
+    struct VFOHeader {
+        uint8_t id;
+        uint8_t compressed;
+    };
 #pragma pack(pop)
 }
\ No newline at end of file
@@ -27,7 +27,8 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     effectiveSr = _sampleRate / _decimRatio;
 
     inBuf.init(in);
-    inBuf.bypass = !buffering;
+    inBuf.setBuffering(buffering);
+    inBuf.setSampleRate(sampleRate);
 
     decim.init(NULL, _decimRatio);
     dcBlock.init(NULL, genDCBlockRate(effectiveSr));
@@ -39,6 +40,7 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     preproc.addBlock(&conjugate, false); // TODO: Replace by parameter
 
     split.init(preproc.out);
+    split.setSharedBuffers(true);
 
     // TODO: Do something to avoid basically repeating this code twice
     int skip;
@@ -66,6 +68,19 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     split.bindStream(&fftIn);
 
+    // The channelizer is only bound to the splitter while it has channels
+    channelizer.init(&channelizerIn, effectiveSr);
+
+    // Names shown in the profiler
+    inBuf.setName("IQFrontEnd / Buffer");
+    decim.setName("IQFrontEnd / Decimator");
+    dcBlock.setName("IQFrontEnd / DC Blocker");
+    conjugate.setName("IQFrontEnd / Conjugate");
+    split.setName("IQFrontEnd / Splitter");
+    reshape.setName("IQFrontEnd / FFT Reshaper");
+    fftSink.setName("IQFrontEnd / FFT");
+    channelizer.setName("IQFrontEnd / Channelizer");
+
     _init = true;
 }
 
@@ -82,8 +97,10 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
 
     // Update the samplerate
     _sampleRate = sampleRate;
+    inBuf.setSampleRate(_sampleRate);
     effectiveSr = _sampleRate / _decimRatio;
     dcBlock.setRate(genDCBlockRate(effectiveSr));
+    channelizer.setInSamplerate(effectiveSr);
     for (auto& [name, vfo] : vfos) {
         vfo->setInSamplerate(effectiveSr);
     }
@@ -99,7 +116,7 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
 }
 
 void IQFrontEnd::setBuffering(bool enabled) {
-    inBuf.bypass = !enabled;
+    inBuf.setBuffering(enabled);
 }
 
 void IQFrontEnd::setDecimation(int ratio) {
@@ -129,6 +146,11 @@ void IQFrontEnd::setInvertIQ(bool enabled) {
     preproc.setBlockEnabled(&conjugate, enabled, [=](dsp::stream<dsp::complex_t>* out){ split.setInput(out); });
 }
 
+void IQFrontEnd::setChannelizer(bool enabled) {
+    // Only affects the VFOs created from now on
+    useChannelizer = enabled;
+}
+
 void IQFrontEnd::bindIQStream(dsp::stream<dsp::complex_t>* stream) {
     split.bindStream(stream);
 }
@@ -144,9 +166,22 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
         return NULL;
     }
 
-    // Create VFO and its input stream
-    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    // Extract the VFO from the shared channelizer, starting it with its first channel
+    if (useChannelizer) {
+        bool first = !channelizer.getChannelCount();
+        dsp::channel::RxVFO* vfo = new dsp::channel::ChannelizerVFO(&channelizer, sampleRate, bandwidth, offset);
+        vfo->setName("VFO: " + name);
+        if (first) { bindIQStream(&channelizerIn); }
+        channelizer.start();
+        vfos[name] = vfo;
+        vfo->start();
+        return vfo;
+    }
+
+    // Create VFO and its input stream, ring backed so that it can hold every buffer of the splitter's pool
+    dsp::stream<dsp::complex_t>* vfoIn = new dsp::ring_stream<dsp::complex_t>(SPLITTER_SHARED_POOL_SIZE + 1);
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
+    vfo->setName("VFO: " + name);
 
     // Register them
     vfoStreams[name] = vfoIn;
@@ -166,9 +201,23 @@ void IQFrontEnd::removeVFO(std::string name) {
         return;
     }
 
+    // Channelized VFOs don't have their own input stream
+    dsp::channel::RxVFO* vfo = vfos[name];
+    if (vfoStreams.find(name) == vfoStreams.end()) {
+        // Deleting the VFO removes its channel from the channelizer
+        vfos.erase(name);
+        delete vfo;
+
+        // Stop the channelizer once it has no channels left
+        if (!channelizer.getChannelCount()) {
+            channelizer.stop();
+            unbindIQStream(&channelizerIn);
+        }
+        return;
+    }
+
     // Remove the VFO and stream from registry
     dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
-    dsp::channel::RxVFO* vfo = vfos[name];
 
     // Stop the VFO
     vfo->stop();
@@ -211,6 +260,9 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
+    // Start the channelizer if any VFO uses it
+    if (channelizer.getChannelCount()) { channelizer.start(); }
+
     // Start all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->start();
@@ -231,6 +283,9 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
+    // Stop the channelizer
+    channelizer.stop();
+
     // Stop all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
@@ -1,11 +1,13 @@
 #pragma once
-#include "../dsp/buffer/frame_buffer.h"
+#include "../dsp/buffer/time_shift.h"
 #include "../dsp/buffer/reshaper.h"
 #include "../dsp/multirate/power_decimator.h"
 #include "../dsp/correction/dc_blocker.h"
 #include "../dsp/chain.h"
+#include "../dsp/ring_stream.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/channelizer_vfo.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
 #include <fftw3.h>
@@ -30,6 +32,7 @@ public:
     void setDecimation(int ratio);
     void setInvertIQ(bool enabled);
     void setDCBlocking(bool enabled);
+    void setChannelizer(bool enabled);
 
     void bindIQStream(dsp::stream<dsp::complex_t>* stream);
     void unbindIQStream(dsp::stream<dsp::complex_t>* stream);
@@ -43,6 +46,9 @@ public:
 
     void flushInputBuffer();
 
+    // Input buffer, also used to rewind the baseband
+    inline dsp::buffer::TimeShiftBuffer* getTimeShift() { return &inBuf; }
+
     void start();
     void stop();
 
@@ -63,7 +69,7 @@ protected:
     }
 
     // Input buffer
-    dsp::buffer::SampleFrameBuffer<dsp::complex_t> inBuf;
+    dsp::buffer::TimeShiftBuffer inBuf;
 
     // Pre-processing chain
     dsp::multirate::PowerDecimator<dsp::complex_t> decim;
@@ -83,6 +89,11 @@ protected:
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
 
+    // Shared channelizer feeding the VFOs created while it's enabled
+    dsp::stream<dsp::complex_t> channelizerIn;
+    dsp::channel::Channelizer channelizer;
+    bool useChannelizer = false;
+
     // Parameters
     double _sampleRate;
     double _decimRatio;
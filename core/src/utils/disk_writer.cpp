@@ -0,0 +1,318 @@
+#include "disk_writer.h"
+#include <utils/flog.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace disk {
+    static uint8_t* allocAligned(size_t size) {
+#ifdef _WIN32
+        return (uint8_t*)_aligned_malloc(size, DISK_WRITER_ALIGNMENT);
+#else
+        void* ptr = NULL;
+        if (posix_memalign(&ptr, DISK_WRITER_ALIGNMENT, size)) { return NULL; }
+        return (uint8_t*)ptr;
+#endif
+    }
+
+    static void freeAligned(uint8_t* ptr) {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+    Writer::~Writer() {
+        close();
+    }
+
+    void Writer::setBatching(size_t batchSize, int batchCount) {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (opened) { throw std::runtime_error("Cannot change batching while file is open"); }
+        batchSize = std::max<size_t>(batchSize, DISK_WRITER_ALIGNMENT);
+        _batchSize = ((batchSize + DISK_WRITER_ALIGNMENT - 1) / DISK_WRITER_ALIGNMENT) * DISK_WRITER_ALIGNMENT;
+        _batchCount = std::max<int>(batchCount, 2);
+    }
+
+    void Writer::setBlocking(bool blocking) {
+        std::lock_guard<std::mutex> lck(mtx);
+        _blocking = blocking;
+        freeCV.notify_all();
+    }
+
+    bool Writer::open(std::string path, bool directIO) {
+        close();
+
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            fileHandle = NULL;
+            return false;
+        }
+        direct = false;
+#else
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        direct = false;
+#ifdef __linux__
+        if (directIO) {
+            fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            if (fd >= 0) {
+                direct = true;
+            }
+            else {
+                flog::warn("Direct IO is not supported for '{0}', using buffered IO instead", path);
+            }
+        }
+#endif
+        if (fd < 0) { fd = ::open(path.c_str(), flags, 0644); }
+        if (fd < 0) { return false; }
+#endif
+
+        // Allocate the batches
+        std::lock_guard<std::mutex> lck(mtx);
+        for (int i = 0; i < _batchCount; i++) {
+            uint8_t* batch = allocAligned(_batchSize);
+            if (!batch) {
+                flog::error("Could not allocate the write batches for '{0}'", path);
+                freeBatches();
+#ifdef _WIN32
+                CloseHandle(fileHandle);
+                fileHandle = NULL;
+#else
+                ::close(fd);
+                fd = -1;
+#endif
+                return false;
+            }
+            batches.push_back(batch);
+            freeList.push_back(batch);
+        }
+
+        // Reset the state and start the worker
+        current = NULL;
+        fill = 0;
+        inFlight = 0;
+        offset = 0;
+        bytesWritten = 0;
+        bytesDropped = 0;
+        overruns = 0;
+        inOverrun = false;
+        failed = false;
+        stopWorker = false;
+        opened = true;
+        workerThread = std::thread(&Writer::worker, this);
+        return true;
+    }
+
+    bool Writer::isOpen() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return opened;
+    }
+
+    void Writer::close() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (!opened) { return; }
+        }
+
+        // Write everything that's left then stop the worker
+        drain();
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            stopWorker = true;
+        }
+        workCV.notify_all();
+        if (workerThread.joinable()) { workerThread.join(); }
+
+        std::lock_guard<std::mutex> lck(mtx);
+#ifdef _WIN32
+        CloseHandle(fileHandle);
+        fileHandle = NULL;
+#else
+        ::close(fd);
+        fd = -1;
+#endif
+        freeBatches();
+        opened = false;
+    }
+
+    bool Writer::write(const uint8_t* data, size_t len) {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (!opened) { return false; }
+
+        // Without blocking, the write must fit in the current batch and the free ones or it's dropped as a whole
+        if (!_blocking) {
+            size_t room = current ? (_batchSize - fill) : 0;
+            size_t needed = (len > room) ? (len - room + _batchSize - 1) / _batchSize : 0;
+            if (failed || needed > freeList.size()) {
+                bytesDropped += len;
+                if (!inOverrun) { overruns++; }
+                inOverrun = true;
+                return false;
+            }
+        }
+        inOverrun = false;
+
+        while (len) {
+            // Get a new batch if needed
+            if (!current) {
+                freeCV.wait(lck, [this]() { return !freeList.empty() || !_blocking; });
+                if (freeList.empty()) {
+                    bytesDropped += len;
+                    overruns++;
+                    return false;
+                }
+                current = freeList.back();
+                freeList.pop_back();
+                fill = 0;
+            }
+
+            // Copy as much as fits and send the batch away once full
+            size_t n = std::min<size_t>(len, _batchSize - fill);
+            memcpy(&current[fill], data, n);
+            fill += n;
+            data += n;
+            len -= n;
+            if (fill == _batchSize) { submit(); }
+        }
+        return true;
+    }
+
+    void Writer::drain() {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (!opened) { return; }
+        if (current && fill) { submit(); }
+        freeCV.wait(lck, [this]() { return !inFlight; });
+    }
+
+    bool Writer::writeAt(uint64_t offset, const uint8_t* data, size_t len) {
+        drain();
+        std::lock_guard<std::mutex> lck(mtx);
+        if (!opened) { return false; }
+
+        // Small unaligned writes aren't possible with direct IO
+        Batch batch = { (uint8_t*)data, len };
+        uint64_t end = this->offset;
+        this->offset = offset;
+        if (len % DISK_WRITER_ALIGNMENT || offset % DISK_WRITER_ALIGNMENT) { direct = false; }
+        bool ok = writeBatch(batch);
+        this->offset = end;
+        return ok;
+    }
+
+    uint64_t Writer::getBytesWritten() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return bytesWritten;
+    }
+
+    uint64_t Writer::getBytesDropped() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return bytesDropped;
+    }
+
+    int Writer::getOverruns() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return overruns;
+    }
+
+    bool Writer::hasFailed() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return failed;
+    }
+
+    void Writer::worker() {
+        while (true) {
+            // Wait for a batch
+            Batch batch;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                workCV.wait(lck, [this]() { return !pending.empty() || stopWorker; });
+                if (pending.empty()) { return; }
+                batch = pending.front();
+                pending.pop_front();
+
+                // The last batch of a file is usually partial, which direct IO can't write
+                if (batch.len % DISK_WRITER_ALIGNMENT) { direct = false; }
+            }
+
+            // Write it without holding the lock
+            bool ok = writeBatch(batch);
+
+            // Give the batch back
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (ok) {
+                    bytesWritten += batch.len;
+                }
+                else if (!failed) {
+                    flog::error("Write to disk failed, further data will be dropped");
+                    failed = true;
+                }
+                freeList.push_back(batch.data);
+                inFlight--;
+            }
+            freeCV.notify_all();
+        }
+    }
+
+    bool Writer::writeBatch(const Batch& batch) {
+#ifdef _WIN32
+        LARGE_INTEGER pos;
+        pos.QuadPart = offset;
+        if (!SetFilePointerEx(fileHandle, pos, NULL, FILE_BEGIN)) { return false; }
+        size_t done = 0;
+        while (done < batch.len) {
+            DWORD written = 0;
+            DWORD n = (DWORD)std::min<size_t>(batch.len - done, 1 << 30);
+            if (!WriteFile(fileHandle, &batch.data[done], n, &written, NULL) || !written) { return false; }
+            done += written;
+        }
+#else
+#ifdef __linux__
+        // Switch back to buffered IO if direct IO was turned off
+        if (!direct) {
+            int flags = fcntl(fd, F_GETFL);
+            if (flags & O_DIRECT) { fcntl(fd, F_SETFL, flags & ~O_DIRECT); }
+        }
+#endif
+        size_t done = 0;
+        while (done < batch.len) {
+            ssize_t written = pwrite(fd, &batch.data[done], batch.len - done, offset + done);
+            if (written < 0 && errno == EINTR) { continue; }
+            if (written <= 0) { return false; }
+            done += written;
+        }
+#endif
+        offset += batch.len;
+        return true;
+    }
+
+    void Writer::submit() {
+        pending.push_back({ current, fill });
+        current = NULL;
+        fill = 0;
+        inFlight++;
+        workCV.notify_one();
+    }
+
+    void Writer::freeBatches() {
+        for (auto& batch : batches) { freeAligned(batch); }
+        batches.clear();
+        freeList.clear();
+        pending.clear();
+        current = NULL;
+        fill = 0;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+
+// Alignment of the batches in memory and on disk, as required for direct IO
+#define DISK_WRITER_ALIGNMENT   4096
+
+namespace disk {
+    // Sequential file writer that hands large batches to a dedicated thread so that the caller never waits on the disk.
+    // When all batches are in flight, writes are either dropped and accounted for, or wait for a batch to be free
+    // depending on the blocking setting.
+    class Writer {
+    public:
+        Writer() {}
+        ~Writer();
+
+        // Batch size is rounded up to the alignment. Can only be changed while the file is closed.
+        void setBatching(size_t batchSize, int batchCount);
+
+        // Wait for a free batch instead of dropping data when the disk can't keep up
+        void setBlocking(bool blocking);
+
+        // Direct IO bypasses the page cache (Linux only), falls back to buffered IO if the filesystem doesn't support it
+        bool open(std::string path, bool directIO = false);
+        bool isOpen();
+
+        // Write everything still queued and close the file
+        void close();
+
+        // Queue data for writing. A write is either fully queued or fully dropped, returns false when dropped.
+        bool write(const uint8_t* data, size_t len);
+
+        // Wait until everything queued so far is on disk
+        void drain();
+
+        // Overwrite already written data, eg. to finalize a header. Drains the queue first.
+        bool writeAt(uint64_t offset, const uint8_t* data, size_t len);
+
+        uint64_t getBytesWritten();
+        uint64_t getBytesDropped();
+        int getOverruns();
+        bool hasFailed();
+
+    private:
+        struct Batch {
+            uint8_t* data;
+            size_t len;
+        };
+
+        void worker();
+        bool writeBatch(const Batch& batch);
+        void submit();
+        void freeBatches();
+
+        std::mutex mtx;
+        std::condition_variable workCV;
+        std::condition_variable freeCV;
+        std::thread workerThread;
+
+        size_t _batchSize = 1 << 20;
+        int _batchCount = 8;
+        bool _blocking = false;
+
+        std::vector<uint8_t*> batches;
+        std::vector<uint8_t*> freeList;
+        std::deque<Batch> pending;
+        uint8_t* current = NULL;
+        size_t fill = 0;
+        int inFlight = 0;
+
+        bool opened = false;
+        bool stopWorker = false;
+        bool failed = false;
+        bool direct = false;
+        bool inOverrun = false;
+        uint64_t offset = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t bytesDropped = 0;
+        int overruns = 0;
+
+#ifdef _WIN32
+        void* fileHandle = NULL;
+#else
+        int fd = -1;
+#endif
+    };
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <regex>
+#include <stdexcept>
+#include <algorithm>
+#include <json.hpp>
+#include <utils/mapped_file.h>
+#include <dsp/convert/iq.h>
+
+#define WAV_CODEC_PCM           1
+#define WAV_CODEC_FLOAT         3
+#define WAV_CODEC_EXTENSIBLE    0xFFFE
+
+#define SIGMF_DATA_EXTENSION    ".sigmf-data"
+#define SIGMF_META_EXTENSION    ".sigmf-meta"
+
+// Memory mapped IQ file, either WAV, RF64, Wave64 or raw samples described by a SigMF metadata file
+class IQReader {
+public:
+    // Throws a std::runtime_error if the file can't be used as an IQ source
+    IQReader(std::string path) {
+        // SigMF recordings can be opened through either of their files
+        if (endsWith(path, SIGMF_DATA_EXTENSION) || endsWith(path, SIGMF_META_EXTENSION)) {
+            openSigMF(path.substr(0, path.size() - strlen(SIGMF_DATA_EXTENSION)));
+            return;
+        }
+
+        if (!file.open(path)) { throw std::runtime_error("Could not open file"); }
+        if (file.size() >= 40 && !memcmp(file.data(), W64_RIFF_GUID, 16)) {
+            parseW64();
+        }
+        else if (file.size() >= 12 && (!memcmp(file.data(), "RIFF", 4) || !memcmp(file.data(), "RF64", 4)) && !memcmp(&file.data()[8], "WAVE", 4)) {
+            parseRIFF();
+        }
+        else {
+            throw std::runtime_error("Unknown file format");
+        }
+    }
+
+    double getSampleRate() { return sampleRate; }
+
+    // Zero if the file doesn't say
+    double getFrequency() { return frequency; }
+
+    uint64_t getSampleCount() { return sampleCount; }
+
+    bool isFloat() { return floatSamples; }
+
+    dsp::convert::IQFormat getFormat() { return format; }
+
+    // Size in bytes of one IQ pair
+    int getSampleSize() { return sampleSize; }
+
+    // Start of the IQ samples in memory
+    const uint8_t* samples() { return &file.data()[dataOffset]; }
+
+    void close() { file.close(); }
+
+private:
+    static bool endsWith(const std::string& str, const std::string& end) {
+        return str.size() >= end.size() && !str.compare(str.size() - end.size(), end.size(), end);
+    }
+
+    template <class T>
+    T readAt(size_t offset) {
+        T val;
+        memcpy(&val, &file.data()[offset], sizeof(T));
+        return val;
+    }
+
+    void parseRIFF() {
+        bool rf64 = !memcmp(file.data(), "RF64", 4);
+        uint64_t ds64DataSize = 0;
+        bool foundFormat = false;
+        size_t pos = 12;
+        while (pos + 8 <= file.size()) {
+            const char* id = (const char*)&file.data()[pos];
+            uint64_t size = readAt<uint32_t>(pos + 4);
+            size_t body = pos + 8;
+
+            if (!memcmp(id, "ds64", 4) && size >= 24 && body + 24 <= file.size()) {
+                ds64DataSize = readAt<uint64_t>(body + 8);
+            }
+            else if (!memcmp(id, "fmt ", 4) && body + 16 <= file.size()) {
+                parseFormat(body, size);
+                foundFormat = true;
+            }
+            else if (!memcmp(id, "data", 4)) {
+                if (!foundFormat) { throw std::runtime_error("Data chunk before format chunk"); }
+                if (rf64 && size == 0xFFFFFFFF) { size = ds64DataSize; }
+                setData(body, size);
+                return;
+            }
+
+            // Chunks are padded to two bytes
+            pos = body + size + (size & 1);
+        }
+        throw std::runtime_error("No data chunk found");
+    }
+
+    void parseW64() {
+        bool foundFormat = false;
+        size_t pos = 40;
+        while (pos + W64_CHUNK_HEADER <= file.size()) {
+            const uint8_t* guid = &file.data()[pos];
+            uint64_t size = readAt<uint64_t>(pos + 16);
+            size_t body = pos + W64_CHUNK_HEADER;
+            if (size < W64_CHUNK_HEADER) { break; }
+
+            if (!memcmp(guid, W64_FMT_GUID, 16) && body + 16 <= file.size()) {
+                parseFormat(body, size - W64_CHUNK_HEADER);
+                foundFormat = true;
+            }
+            else if (!memcmp(guid, W64_DATA_GUID, 16)) {
+                if (!foundFormat) { throw std::runtime_error("Data chunk before format chunk"); }
+                setData(body, size - W64_CHUNK_HEADER);
+                return;
+            }
+
+            // Chunks are padded to eight bytes and their size includes the header
+            pos += (size + 7) & ~7ull;
+        }
+        throw std::runtime_error("No data chunk found");
+    }
+
+    void parseFormat(size_t offset, uint64_t size) {
+        uint16_t codec = readAt<uint16_t>(offset);
+        uint16_t channels = readAt<uint16_t>(offset + 2);
+        sampleRate = readAt<uint32_t>(offset + 4);
+        uint16_t bitDepth = readAt<uint16_t>(offset + 14);
+
+        // The actual codec is at the start of the sub-format GUID
+        if (codec == WAV_CODEC_EXTENSIBLE && size >= 26 && offset + 26 <= file.size()) {
+            codec = readAt<uint16_t>(offset + 24);
+        }
+
+        if (channels != 2) { throw std::runtime_error("IQ files must have two channels"); }
+        if (codec == WAV_CODEC_FLOAT && bitDepth == 32) {
+            setType(true, dsp::convert::IQ_FORMAT_I16, 8);
+            return;
+        }
+        if (codec != WAV_CODEC_PCM) { throw std::runtime_error("Unsupported codec"); }
+        switch (bitDepth) {
+        case 8:
+            setType(false, dsp::convert::IQ_FORMAT_U8, 2);
+            break;
+        case 16:
+            setType(false, dsp::convert::IQ_FORMAT_I16, 4);
+            break;
+        case 32:
+            setType(false, dsp::convert::IQ_FORMAT_I32, 8);
+            break;
+        default:
+            throw std::runtime_error("Unsupported bit depth");
+        }
+    }
+
+    void openSigMF(std::string basePath) {
+        // Load the metadata
+        std::ifstream metaFile(basePath + SIGMF_META_EXTENSION);
+        if (!metaFile.is_open()) { throw std::runtime_error("Could not open the SigMF metadata"); }
+        nlohmann::json meta;
+        try {
+            meta = nlohmann::json::parse(metaFile);
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Invalid SigMF metadata");
+        }
+        if (!meta.contains("global") || !meta["global"].contains("core:datatype") || !meta["global"].contains("core:sample_rate")) {
+            throw std::runtime_error("SigMF metadata is missing the datatype or sample rate");
+        }
+
+        // Only complex little endian types can be used
+        std::string datatype = meta["global"]["core:datatype"];
+        std::smatch match;
+        if (!std::regex_match(datatype, match, std::regex("c(u8|i8|i16|i32|f32)(_le)?"))) {
+            throw std::runtime_error("Unsupported SigMF datatype: " + datatype);
+        }
+        std::string type = match[1].str();
+        if (type == "u8") { setType(false, dsp::convert::IQ_FORMAT_U8, 2); }
+        else if (type == "i8") { setType(false, dsp::convert::IQ_FORMAT_I8, 2); }
+        else if (type == "i16") { setType(false, dsp::convert::IQ_FORMAT_I16, 4); }
+        else if (type == "i32") { setType(false, dsp::convert::IQ_FORMAT_I32, 8); }
+        else { setType(true, dsp::convert::IQ_FORMAT_I16, 8); }
+        sampleRate = meta["global"]["core:sample_rate"];
+
+        // Use the frequency of the first capture
+        auto& captures = meta["captures"];
+        if (captures.is_array() && !captures.empty() && captures[0].contains("core:frequency")) {
+            frequency = captures[0]["core:frequency"];
+        }
+
+        if (!file.open(basePath + SIGMF_DATA_EXTENSION)) { throw std::runtime_error("Could not open the SigMF data"); }
+        setData(0, file.size());
+    }
+
+    void setType(bool isFloat, dsp::convert::IQFormat fmt, int size) {
+        floatSamples = isFloat;
+        format = fmt;
+        sampleSize = size;
+    }
+
+    void setData(size_t offset, uint64_t size) {
+        // Files still being written or cut short may claim more than they have
+        if (offset > file.size()) { offset = file.size(); }
+        size = std::min<uint64_t>(size, file.size() - offset);
+        dataOffset = offset;
+        sampleCount = size / sampleSize;
+        if (sampleRate <= 0) { throw std::runtime_error("Sample rate may not be zero"); }
+        if (!sampleCount) { throw std::runtime_error("File contains no samples"); }
+        file.adviseSequential();
+    }
+
+    static constexpr uint8_t W64_RIFF_GUID[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+    static constexpr uint8_t W64_FMT_GUID[16]  = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    static constexpr uint8_t W64_DATA_GUID[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    static constexpr size_t W64_CHUNK_HEADER = 24;
+
+    mapped::File file;
+    double sampleRate = 0;
+    double frequency = 0;
+    uint64_t sampleCount = 0;
+    size_t dataOffset = 0;
+    bool floatSamples = false;
+    dsp::convert::IQFormat format = dsp::convert::IQ_FORMAT_I16;
+    int sampleSize = 4;
+};
@@ -0,0 +1,136 @@
+#include "mapped_file.h"
+#include <utils/flog.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace mapped {
+    File::~File() {
+        close();
+    }
+
+    bool File::create(std::string path, size_t size) {
+        close();
+        if (!size) { return false; }
+        _size = size;
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            fileHandle = NULL;
+            flog::error("Could not create '{0}'", path);
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            flog::error("Could not create '{0}'", path);
+            return false;
+        }
+
+        // Reserve the space now so that running out of disk doesn't crash the process later on with a SIGBUS
+#ifdef __linux__
+        if (posix_fallocate(fd, 0, size)) {
+            flog::error("Could not allocate {0} bytes for '{1}'", (uint64_t)size, path);
+            close();
+            return false;
+        }
+#else
+        if (ftruncate(fd, size)) {
+            flog::error("Could not resize '{0}'", path);
+            close();
+            return false;
+        }
+#endif
+#endif
+        return map(true);
+    }
+
+    bool File::open(std::string path) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            fileHandle = NULL;
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(fileHandle, &size)) {
+            close();
+            return false;
+        }
+        _size = size.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st)) {
+            close();
+            return false;
+        }
+        _size = st.st_size;
+#endif
+        // Empty files can't be mapped
+        if (!_size) {
+            close();
+            return false;
+        }
+        return map(false);
+    }
+
+    bool File::isOpen() {
+        return _data != NULL;
+    }
+
+    void File::close() {
+#ifdef _WIN32
+        if (_data) { UnmapViewOfFile(_data); }
+        if (mapHandle) { CloseHandle(mapHandle); }
+        if (fileHandle) { CloseHandle(fileHandle); }
+        mapHandle = NULL;
+        fileHandle = NULL;
+#else
+        if (_data) { munmap(_data, _size); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        _data = NULL;
+        _size = 0;
+    }
+
+    void File::adviseSequential() {
+        if (!_data) { return; }
+#ifndef _WIN32
+        posix_madvise(_data, _size, POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+
+    bool File::map(bool writable) {
+#ifdef _WIN32
+        mapHandle = CreateFileMappingA(fileHandle, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)((uint64_t)_size >> 32), (DWORD)(_size & 0xFFFFFFFF), NULL);
+        if (!mapHandle) {
+            close();
+            return false;
+        }
+        _data = (uint8_t*)MapViewOfFile(mapHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, _size);
+        if (!_data) {
+            close();
+            return false;
+        }
+#else
+        void* ptr = mmap(NULL, _size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close();
+            return false;
+        }
+        _data = (uint8_t*)ptr;
+#endif
+        return true;
+    }
+}
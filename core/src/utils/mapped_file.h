@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace mapped {
+    // File mapped in memory, either created with a fixed size for writing or opened read-only
+    class File {
+    public:
+        File() {}
+        ~File();
+
+        // Create or truncate the file to the given size and map it for reading and writing
+        bool create(std::string path, size_t size);
+
+        // Map an existing file for reading
+        bool open(std::string path);
+
+        bool isOpen();
+        void close();
+
+        // Hint the OS that the mapping will be accessed from start to end
+        void adviseSequential();
+
+        uint8_t* data() { return _data; }
+        size_t size() { return _size; }
+
+    private:
+        bool map(bool writable);
+
+        uint8_t* _data = NULL;
+        size_t _size = 0;
+#ifdef _WIN32
+        void* fileHandle = NULL;
+        void* mapHandle = NULL;
+#else
+        int fd = -1;
+#endif
+    };
+}
@@ -3,8 +3,15 @@
 #include <stdexcept>
 #include <dsp/buffer/buffer.h>
 #include <dsp/stream.h>
+#include <utils/flog.h>
+#include <json.hpp>
+#include <fstream>
+#include <algorithm>
+#include <ctime>
 #include <map>
 
+using nlohmann::json;
+
 namespace wav {
     const char* WAVE_FILE_TYPE          = "WAVE";
     const char* FORMAT_MARKER           = "fmt ";
@@ -12,12 +19,42 @@ namespace wav {
     const uint32_t FORMAT_HEADER_LEN    = 16;
     const uint16_t SAMPLE_TYPE_PCM      = 1;
 
+    // The header is padded so that the samples start on a boundary suitable for direct IO
+    const size_t HEADER_SIZE            = DISK_WRITER_ALIGNMENT;
+    const uint32_t DS64_LEN             = 28;
+    const uint64_t RIFF_MAX_SIZE        = 0xFFFFFFFF;
+
+    // Batches of about 250ms with 2s worth of them before samples get dropped
+    const double BATCH_DURATION         = 0.25;
+    const double QUEUE_DURATION         = 2.0;
+    const size_t MIN_BATCH_SIZE         = 64 * 1024;
+    const size_t MAX_BATCH_SIZE         = 8 * 1024 * 1024;
+    const int MIN_BATCH_COUNT           = 4;
+    const int MAX_BATCH_COUNT           = 32;
+
+    const size_t MAX_SIGMF_GAPS         = 1024;
+
+    // Wave64 chunk GUIDs
+    const uint8_t W64_RIFF_GUID[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+    const uint8_t W64_WAVE_GUID[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    const uint8_t W64_FMT_GUID[16]  = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    const uint8_t W64_JUNK_GUID[16] = { 'j', 'u', 'n', 'k', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    const uint8_t W64_DATA_GUID[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+    const size_t W64_CHUNK_HEADER   = 24;
+
     std::map<SampleType, int> SAMP_BITS = {
         { SAMP_TYPE_UINT8, 8 },
         { SAMP_TYPE_INT16, 16 },
         { SAMP_TYPE_INT32, 32 },
         { SAMP_TYPE_FLOAT32, 32 }
     };
+
+    std::map<SampleType, const char*> SIGMF_TYPES = {
+        { SAMP_TYPE_UINT8, "u8" },
+        { SAMP_TYPE_INT16, "i16_le" },
+        { SAMP_TYPE_INT32, "i32_le" },
+        { SAMP_TYPE_FLOAT32, "f32_le" }
+    };
     
     Writer::Writer(int channels, uint64_t samplerate, Format format, SampleType type) {
         // Validate channels and samplerate
@@ -36,10 +73,14 @@ namespace wav {
     bool Writer::open(std::string path) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Close previous file
-        if (rw.isOpen()) { close(); }
+        if (dw.isOpen()) { close(); }
 
         // Reset work values
         samplesWritten = 0;
+        samplesDropped = 0;
+        gaps.clear();
+        startTime = time(NULL);
+        _path = path;
 
         // Fill header
         bytesPerSamp = (SAMP_BITS[_type] / 8) * _channels;
@@ -49,6 +90,7 @@ namespace wav {
         hdr.bitDepth = SAMP_BITS[_type];
         hdr.bytesPerSample = bytesPerSamp;
         hdr.bytesPerSecond = bytesPerSamp * _samplerate;
+        headerSize = (_format == FORMAT_RAW) ? 0 : HEADER_SIZE;
 
         // Precompute sizes and allocate buffers
         switch (_type) {
@@ -68,35 +110,61 @@ namespace wav {
             break;
         }
 
-        // Open file
-        if (!rw.open(path, WAVE_FILE_TYPE)) { return false; }
+        // Size the write batches after the data rate
+        double bytesPerSecond = (double)bytesPerSamp * (double)_samplerate;
+        size_t batchSize = std::clamp<size_t>(bytesPerSecond * BATCH_DURATION, MIN_BATCH_SIZE, MAX_BATCH_SIZE);
+        int batchCount = std::clamp<int>((bytesPerSecond * QUEUE_DURATION) / batchSize, MIN_BATCH_COUNT, MAX_BATCH_COUNT);
+        dw.setBatching(batchSize, batchCount);
+        dw.setBlocking(_blocking);
 
-        // Write format chunk
-        rw.beginChunk(FORMAT_MARKER);
-        rw.write((uint8_t*)&hdr, sizeof(FormatHeader));
-        rw.endChunk();
+        // Open file
+        if (!dw.open(path, _directIO)) { return false; }
 
-        // Begin data chunk
-        rw.beginChunk(DATA_MARKER);
+        // Write a placeholder header, it gets its final sizes on close
+        if (headerSize) {
+            uint8_t buf[HEADER_SIZE];
+            buildHeader(buf, 0);
+            dw.write(buf, HEADER_SIZE);
+        }
         
         return true;
     }
 
     bool Writer::isOpen() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        return rw.isOpen();
+        return dw.isOpen();
     }
 
     void Writer::close() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do nothing if the file is not open
-        if (!rw.isOpen()) { return; }
+        if (!dw.isOpen()) { return; }
+
+        // Chunks are padded to two bytes in RIFF and to eight bytes in Wave64
+        uint64_t dataBytes = (uint64_t)samplesWritten * bytesPerSamp;
+        const uint8_t zeros[8] = { 0 };
+        dw.setBlocking(true);
+        if (_format == FORMAT_W64 && (dataBytes % 8)) {
+            dw.write(zeros, 8 - (dataBytes % 8));
+        }
+        else if ((_format == FORMAT_WAV || _format == FORMAT_RF64) && (dataBytes & 1)) {
+            dw.write(zeros, 1);
+        }
 
-        // Finish data chunk
-        rw.endChunk();
+        // Finalize the header
+        if (headerSize) {
+            uint8_t buf[HEADER_SIZE];
+            buildHeader(buf, dataBytes);
+            if (!dw.writeAt(0, buf, HEADER_SIZE)) {
+                flog::error("Could not finalize the header of '{0}'", _path);
+            }
+        }
 
         // Close the file
-        rw.close();
+        dw.close();
+        if (_format == FORMAT_RAW && !writeSigMF()) {
+            flog::error("Could not write the SigMF metadata of '{0}'", _path);
+        }
 
         // Free buffers
         if (bufU8) {
@@ -116,7 +184,7 @@ namespace wav {
     void Writer::setChannels(int channels) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (dw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
 
         // Validate channel count
         if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
@@ -126,7 +194,7 @@ namespace wav {
     void Writer::setSamplerate(uint64_t samplerate) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (dw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
 
         // Validate samplerate
         if (!samplerate) { throw std::runtime_error("Samplerate must be non-zero"); }
@@ -136,48 +204,188 @@ namespace wav {
     void Writer::setFormat(Format format) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (dw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
         _format = format;
     }
 
     void Writer::setSampleType(SampleType type) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (dw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
         _type = type;
     }
 
+    void Writer::setMetadata(const Metadata& metadata) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        _metadata = metadata;
+    }
+
+    void Writer::setBlocking(bool blocking) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        _blocking = blocking;
+        dw.setBlocking(blocking);
+    }
+
+    void Writer::setDirectIO(bool directIO) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (dw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _directIO = directIO;
+    }
+
     void Writer::write(float* samples, int count) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        if (!rw.isOpen()) { return; }
+        if (!dw.isOpen()) { return; }
         
         // Select different writer function depending on the chose depth
         int tcount = count * _channels;
         int tbytes = count * bytesPerSamp;
+        uint8_t* data = NULL;
         switch (_type) {
         case SAMP_TYPE_UINT8:
             // Volk doesn't support unsigned ints yet :/
             for (int i = 0; i < tcount; i++) {
                 bufU8[i] = (samples[i] * 127.0f) + 128.0f;
             }
-            rw.write(bufU8, tbytes);
+            data = bufU8;
             break;
         case SAMP_TYPE_INT16:
             volk_32f_s32f_convert_16i(bufI16, samples, 32767.0f, tcount);
-            rw.write((uint8_t*)bufI16, tbytes);
+            data = (uint8_t*)bufI16;
             break;
         case SAMP_TYPE_INT32:
             volk_32f_s32f_convert_32i(bufI32, samples, 2147483647.0f, tcount);
-            rw.write((uint8_t*)bufI32, tbytes);
+            data = (uint8_t*)bufI32;
             break;
         case SAMP_TYPE_FLOAT32:
-            rw.write((uint8_t*)samples, tbytes);
+            data = (uint8_t*)samples;
             break;
         default:
-            break;
+            return;
+        }
+
+        // Keep track of where samples went missing
+        if (!dw.write(data, tbytes)) {
+            samplesDropped += count;
+            if (!gaps.empty() && gaps.back().first == samplesWritten) {
+                gaps.back().second += count;
+            }
+            else if (gaps.size() < MAX_SIGMF_GAPS) {
+                gaps.push_back({ samplesWritten, count });
+            }
+            return;
         }
 
         // Increment sample counter
         samplesWritten += count;
     }
+
+    const char* Writer::extension(Format format) {
+        switch (format) {
+        case FORMAT_W64:
+            return ".w64";
+        case FORMAT_RAW:
+            return ".sigmf-data";
+        default:
+            return ".wav";
+        }
+    }
+
+    void Writer::buildHeader(uint8_t* buf, uint64_t dataBytes) {
+        memset(buf, 0, HEADER_SIZE);
+        size_t pos = 0;
+        auto put = [&](const void* data, size_t len) {
+            memcpy(&buf[pos], data, len);
+            pos += len;
+        };
+        auto put32 = [&](uint32_t val) { put(&val, sizeof(val)); };
+        auto put64 = [&](uint64_t val) { put(&val, sizeof(val)); };
+
+        if (_format == FORMAT_W64) {
+            // Wave64 sizes are 64bit and include the chunk headers
+            uint64_t paddedBytes = (dataBytes + 7) & ~7ull;
+            put(W64_RIFF_GUID, 16);
+            put64(HEADER_SIZE + paddedBytes);
+            put(W64_WAVE_GUID, 16);
+            put(W64_FMT_GUID, 16);
+            put64(W64_CHUNK_HEADER + sizeof(FormatHeader));
+            put(&hdr, sizeof(FormatHeader));
+            put(W64_JUNK_GUID, 16);
+            put64(HEADER_SIZE - W64_CHUNK_HEADER - (pos - 16));
+            pos = HEADER_SIZE - W64_CHUNK_HEADER;
+            put(W64_DATA_GUID, 16);
+            put64(W64_CHUNK_HEADER + dataBytes);
+            return;
+        }
+
+        // The ds64 chunk is written as a JUNK chunk until the file needs to be RF64 (EBU Tech 3306)
+        uint64_t riffSize = (HEADER_SIZE - 8) + dataBytes + (dataBytes & 1);
+        bool rf64 = (_format == FORMAT_RF64 || riffSize > RIFF_MAX_SIZE);
+        put(rf64 ? "RF64" : "RIFF", 4);
+        put32(rf64 ? RIFF_MAX_SIZE : riffSize);
+        put(WAVE_FILE_TYPE, 4);
+        put(rf64 ? "ds64" : "JUNK", 4);
+        put32(DS64_LEN);
+        if (rf64) {
+            put64(riffSize);
+            put64(dataBytes);
+            put64(dataBytes / bytesPerSamp);
+            put32(0);
+        }
+        else {
+            pos += DS64_LEN;
+        }
+        put(FORMAT_MARKER, 4);
+        put32(FORMAT_HEADER_LEN);
+        put(&hdr, sizeof(FormatHeader));
+
+        // Pad up to the data chunk
+        put("JUNK", 4);
+        put32(HEADER_SIZE - pos - 4 - 8);
+        pos = HEADER_SIZE - 8;
+        put(DATA_MARKER, 4);
+        put32(rf64 ? RIFF_MAX_SIZE : dataBytes);
+    }
+
+    bool Writer::writeSigMF() {
+        // The metadata goes next to the data file
+        std::string metaPath = _path;
+        std::string dataExt = extension(FORMAT_RAW);
+        if (metaPath.size() >= dataExt.size() && !metaPath.compare(metaPath.size() - dataExt.size(), dataExt.size(), dataExt)) {
+            metaPath = metaPath.substr(0, metaPath.size() - dataExt.size());
+        }
+        metaPath += ".sigmf-meta";
+
+        char datetime[64];
+        strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&startTime));
+
+        json meta;
+        meta["global"]["core:datatype"] = std::string(_metadata.complex ? "c" : "r") + SIGMF_TYPES[_type];
+        meta["global"]["core:sample_rate"] = _samplerate;
+        meta["global"]["core:version"] = "1.0.0";
+        meta["global"]["core:recorder"] = "SDR++";
+        if (!_metadata.complex) { meta["global"]["core:num_channels"] = _channels; }
+        if (!_metadata.description.empty()) { meta["global"]["core:description"] = _metadata.description; }
+
+        json capture;
+        capture["core:sample_start"] = 0;
+        capture["core:datetime"] = datetime;
+        if (_metadata.frequency != 0.0) { capture["core:frequency"] = _metadata.frequency; }
+        meta["captures"] = json::array({ capture });
+
+        // Mark the places where samples were dropped
+        meta["annotations"] = json::array();
+        for (const auto& [start, count] : gaps) {
+            json ann;
+            ann["core:sample_start"] = start;
+            ann["core:sample_count"] = 0;
+            ann["core:comment"] = std::to_string(count) + " samples dropped";
+            meta["annotations"].push_back(ann);
+        }
+
+        std::ofstream file(metaPath, std::ios::out);
+        if (!file.is_open()) { return false; }
+        file << meta.dump(4);
+        return file.good();
+    }
 }
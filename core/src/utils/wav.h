@@ -1,9 +1,9 @@
 #pragma once
 #include <string>
-#include <fstream>
 #include <stdint.h>
 #include <mutex>
-#include "riff.h"
+#include <vector>
+#include "disk_writer.h"
 
 namespace wav {    
     #pragma pack(push, 1)
@@ -18,8 +18,13 @@ namespace wav {
     #pragma pack(pop)
 
     enum Format {
+        // Switches to RF64 on close if the file went over 4GB
         FORMAT_WAV,
-        FORMAT_RF64
+        FORMAT_RF64,
+        // Sony Wave64
+        FORMAT_W64,
+        // Headerless samples with a SigMF metadata file next to them
+        FORMAT_RAW
     };
 
     enum SampleType {
@@ -34,6 +39,13 @@ namespace wav {
         CODEC_FLOAT = 3
     };
 
+    // Only used by containers that can store it (SigMF)
+    struct Metadata {
+        bool complex = false;
+        double frequency = 0.0;
+        std::string description;
+    };
+
     class Writer {
     public:
         Writer(int channels = 2, uint64_t samplerate = 48000, Format format = FORMAT_WAV, SampleType type = SAMP_TYPE_INT16);
@@ -47,25 +59,48 @@ namespace wav {
         void setSamplerate(uint64_t samplerate);
         void setFormat(Format format);
         void setSampleType(SampleType type);
+        void setMetadata(const Metadata& metadata);
+
+        // When not blocking, samples the disk can't keep up with are dropped instead of stalling the caller
+        void setBlocking(bool blocking);
+        void setDirectIO(bool directIO);
 
         size_t getSamplesWritten() { return samplesWritten; }
+        size_t getSamplesDropped() { return samplesDropped; }
+        int getOverruns() { return dw.getOverruns(); }
 
         void write(float* samples, int count);
 
+        // File extension matching a container
+        static const char* extension(Format format);
+
     private:
+        void buildHeader(uint8_t* buf, uint64_t dataBytes);
+        bool writeSigMF();
+
         std::recursive_mutex mtx;
         FormatHeader hdr;
-        riff::Writer rw;
+        disk::Writer dw;
+        std::string _path;
 
         int _channels;
         uint64_t _samplerate;
         Format _format;
         SampleType _type;
+        Metadata _metadata;
+        bool _blocking = true;
+        bool _directIO = false;
         size_t bytesPerSamp;
+        size_t headerSize;
+        time_t startTime;
 
         uint8_t* bufU8 = NULL;
         int16_t* bufI16 = NULL;
         int32_t* bufI32 = NULL;
         size_t samplesWritten = 0;
+        size_t samplesDropped = 0;
+
+        // Start and length of each run of dropped samples, in written samples
+        std::vector<std::pair<uint64_t, uint64_t>> gaps;
     };
 }
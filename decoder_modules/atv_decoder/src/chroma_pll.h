@@ -22,21 +22,21 @@ namespace dsp::loop {
         inline int process(int count, complex_t* in, complex_t* out, bool aphase = false) {
             // Process the pre-burst section
             for (int i = 0; i < BURST_START; i++) {
-                out[i] = in[i] * math::phasor(-pcl.phase);
+                out[i] = in[i] * math::NCO::phasor(-pcl.phase);
                 pcl.advancePhase();
             }
 
             // Process the burst itself
             if (aphase) {
                 for (int i = BURST_START; i < BURST_END; i++) {
-                    complex_t outVal = in[i] * math::phasor(-pcl.phase);
+                    complex_t outVal = in[i] * math::NCO::phasor(-pcl.phase);
                     out[i] = outVal;
                     pcl.advance(math::normalizePhase(outVal.phase() - A_PHASE));
                 }
             }
             else {
                 for (int i = BURST_START; i < BURST_END; i++) {
-                    complex_t outVal = in[i] * math::phasor(-pcl.phase);
+                    complex_t outVal = in[i] * math::NCO::phasor(-pcl.phase);
                     out[i] = outVal;
                     pcl.advance(math::normalizePhase(outVal.phase() - B_PHASE));
                 }
@@ -45,7 +45,7 @@ namespace dsp::loop {
             
             // Process the post-burst section
             for (int i = BURST_END; i < count; i++) {
-                out[i] = in[i] * math::phasor(-pcl.phase);
+                out[i] = in[i] * math::NCO::phasor(-pcl.phase);
                 pcl.advancePhase();
             }
 
@@ -54,7 +54,7 @@ namespace dsp::loop {
 
         inline int processBlank(int count, complex_t* in, complex_t* out) {
             for (int i = 0; i < count; i++) {
-                out[i] = in[i] * math::phasor(-pcl.phase);
+                out[i] = in[i] * math::NCO::phasor(-pcl.phase);
                 pcl.advancePhase();
             }
             return count;
@@ -35,6 +35,7 @@ namespace demod {
 
             // Define structure
             demod.init(input, tone, agcAttack / getIFSampleRate(), agcDecay / getIFSampleRate(), getIFSampleRate());
+            demod.setName(name + " / " + getName());
         }
 
         void start() { demod.start(); }
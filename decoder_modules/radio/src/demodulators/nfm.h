@@ -30,6 +30,7 @@ namespace demod {
 
             // Define structure
             demod.init(input, getIFSampleRate(), bandwidth, _lowPass, _highPass);
+            demod.setName(name + " / " + getName());
         }
 
         void start() { demod.start(); }
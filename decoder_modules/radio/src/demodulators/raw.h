@@ -21,6 +21,7 @@ namespace demod {
 
             // Define structure
             c2s.init(input);
+            c2s.setName(name + " / " + getName());
         }
 
         void start() {
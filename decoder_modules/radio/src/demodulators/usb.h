@@ -32,6 +32,7 @@ namespace demod {
 
             // Define structure
             demod.init(input, dsp::demod::SSB<dsp::stereo_t>::Mode::USB, bandwidth, getIFSampleRate(), agcAttack / getIFSampleRate(), agcDecay / getIFSampleRate());
+            demod.setName(name + " / " + getName());
         }
 
         void start() { demod.start(); }
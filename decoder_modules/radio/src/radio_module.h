@@ -9,6 +9,7 @@
 #include <dsp/noise_reduction/noise_blanker.h>
 #include <dsp/noise_reduction/fm_if.h>
 #include <dsp/noise_reduction/squelch.h>
+#include <dsp/noise_reduction/blanker_squelch.h>
 #include <dsp/multirate/rational_resampler.h>
 #include <dsp/filter/deephasis.h>
 #include <core.h>
@@ -73,11 +74,18 @@ public:
         nb.init(NULL, 500.0 / 24000.0, 10.0);
         fmnr.init(NULL, 32);
         squelch.init(NULL, MIN_SQUELCH);
+        nbSquelch.init(NULL, 500.0 / 24000.0, 10.0, MIN_SQUELCH);
 
         ifChain.addBlock(&nb, false);
         ifChain.addBlock(&squelch, false);
+        ifChain.addBlock(&nbSquelch, false);
         ifChain.addBlock(&fmnr, false);
 
+        nb.setName(name + " / Noise Blanker");
+        squelch.setName(name + " / Squelch");
+        nbSquelch.setName(name + " / Noise Blanker + Squelch");
+        fmnr.setName(name + " / FM IF NR");
+
         // Initialize audio DSP chain
         afChain.init(&dummyAudioStream);
 
@@ -87,6 +95,9 @@ public:
         afChain.addBlock(&resamp, true);
         afChain.addBlock(&deemp, false);
 
+        resamp.setName(name + " / Audio Resampler");
+        deemp.setName(name + " / Deemphasis");
+
         // Initialize the sink
         srChangeHandler.ctx = this;
         srChangeHandler.handler = sampleRateChangeHandler;
@@ -426,6 +437,7 @@ private:
 
         // Configure noise blanker
         nb.setRate(500.0 / ifSamplerate);
+        nbSquelch.setRate(500.0 / ifSamplerate);
         setNBLevel(nbLevel);
         setNBEnabled(nbAllowed && nbEnabled);
 
@@ -511,7 +523,7 @@ private:
     void setNBEnabled(bool enable) {
         nbEnabled = enable;
         if (!selectedDemod) { return; }
-        ifChain.setBlockEnabled(&nb, nbEnabled, [=](dsp::stream<dsp::complex_t>* out){ selectedDemod->setInput(out); });
+        updateIFBlocks();
 
         // Save config
         config.acquire();
@@ -522,6 +534,7 @@ private:
     void setNBLevel(float level) {
         nbLevel = std::clamp<float>(level, MIN_NB, MAX_NB);
         nb.setLevel(nbLevel);
+        nbSquelch.setLevel(nbLevel);
 
         // Save config
         config.acquire();
@@ -532,7 +545,7 @@ private:
     void setSquelchEnabled(bool enable) {
         squelchEnabled = enable;
         if (!selectedDemod) { return; }
-        ifChain.setBlockEnabled(&squelch, squelchEnabled, [=](dsp::stream<dsp::complex_t>* out){ selectedDemod->setInput(out); });
+        updateIFBlocks();
 
         // Save config
         config.acquire();
@@ -543,6 +556,7 @@ private:
     void setSquelchLevel(float level) {
         squelchLevel = std::clamp<float>(level, MIN_SQUELCH, MAX_SQUELCH);
         squelch.setLevel(squelchLevel);
+        nbSquelch.setSquelchLevel(squelchLevel);
 
         // Save config
         config.acquire();
@@ -550,6 +564,14 @@ private:
         config.release(true);
     }
 
+    void updateIFBlocks() {
+        // When both are enabled, the noise blanker and squelch run as a single block
+        bool fused = nbEnabled && squelchEnabled;
+        ifChain.setBlockEnabled(&nb, nbEnabled && !fused, [=](dsp::stream<dsp::complex_t>* out){ selectedDemod->setInput(out); });
+        ifChain.setBlockEnabled(&squelch, squelchEnabled && !fused, [=](dsp::stream<dsp::complex_t>* out){ selectedDemod->setInput(out); });
+        ifChain.setBlockEnabled(&nbSquelch, fused, [=](dsp::stream<dsp::complex_t>* out){ selectedDemod->setInput(out); });
+    }
+
     void setFMIFNREnabled(bool enabled) {
         FMIFNREnabled = enabled;
         if (!selectedDemod) { return; }
@@ -654,6 +676,7 @@ private:
     dsp::noise_reduction::NoiseBlanker nb;
     dsp::noise_reduction::FMIF fmnr;
     dsp::noise_reduction::Squelch squelch;
+    dsp::noise_reduction::BlankerSquelch nbSquelch;
 
     // Audio chain
     dsp::stream<dsp::stereo_t> dummyAudioStream;
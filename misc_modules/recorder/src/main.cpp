@@ -46,7 +46,9 @@ public:
 
         // Define option lists
         containers.define("WAV", wav::FORMAT_WAV);
-        // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("RF64", wav::FORMAT_RF64);
+        containers.define("W64", wav::FORMAT_W64);
+        containers.define("SigMF", wav::FORMAT_RAW);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
@@ -82,6 +84,9 @@ public:
         if (config.conf[name].contains("ignoreSilence")) {
             ignoreSilence = config.conf[name]["ignoreSilence"];
         }
+        if (config.conf[name].contains("directIO")) {
+            directIO = config.conf[name]["directIO"];
+        }
         if (config.conf[name].contains("nameTemplate")) {
             std::string _nameTemplate = config.conf[name]["nameTemplate"];
             if (_nameTemplate.length() > sizeof(nameTemplate)-1) {
@@ -166,11 +171,23 @@ public:
         writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
         writer.setSampleType(sampleTypes[sampleTypeId]);
         writer.setSamplerate(samplerate);
+        writer.setDirectIO(directIO);
+
+        // Never let the disk stall the DSP, samples that can't be written in time are dropped and counted instead
+        writer.setBlocking(false);
 
         // Open file
         std::string type = (recMode == RECORDER_MODE_AUDIO) ? "audio" : "baseband";
         std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-        std::string extension = ".wav";
+        std::string extension = wav::Writer::extension(containers[containerId]);
+        wav::Metadata meta;
+        meta.complex = (recMode == RECORDER_MODE_BASEBAND);
+        meta.frequency = gui::waterfall.getCenterFrequency();
+        if (gui::waterfall.vfos.find(vfoName) != gui::waterfall.vfos.end()) {
+            meta.frequency += gui::waterfall.vfos[vfoName]->generalOffset;
+        }
+        meta.description = "SDR++ " + type + " recording";
+        writer.setMetadata(meta);
         std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, type, vfoName) + extension);
         if (!writer.open(expandedPath)) {
             flog::error("Failed to open file for recording: {0}", expandedPath);
@@ -221,6 +238,9 @@ public:
 
         // Close file
         writer.close();
+        if (writer.getSamplesDropped()) {
+            flog::warn("Recording dropped {0} samples in {1} overruns, the disk couldn't keep up", (uint64_t)writer.getSamplesDropped(), writer.getOverruns());
+        }
         
         recording = false;
     }
@@ -284,6 +304,16 @@ private:
             config.release(true);
         }
 
+#ifdef __linux__
+        if (_this->recording) { style::beginDisabled(); }
+        if (ImGui::Checkbox(CONCAT("Bypass page cache##_recorder_direct_io_", _this->name), &_this->directIO)) {
+            config.acquire();
+            config.conf[_this->name]["directIO"] = _this->directIO;
+            config.release(true);
+        }
+        if (_this->recording) { style::endDisabled(); }
+#endif
+
         // Show additional audio options
         if (_this->recMode == RECORDER_MODE_AUDIO) {
             ImGui::LeftLabel("Stream");
@@ -347,6 +377,12 @@ private:
             else {
                 ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
             }
+
+            // Let the user know if the disk isn't keeping up
+            uint64_t dropped = _this->writer.getSamplesDropped();
+            if (dropped) {
+                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Dropped %llu samples (%d overruns)", (unsigned long long)dropped, _this->writer.getOverruns());
+            }
         }
     }
 
@@ -570,6 +606,7 @@ private:
     std::string selectedStreamName = "";
     float audioVolume = 1.0f;
     bool ignoreSilence = false;
+    bool directIO = false;
     dsp::stereo_t audioLvl = { -100.0f, -100.0f };
 
     bool recording = false;
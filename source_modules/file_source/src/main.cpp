@@ -4,22 +4,30 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
-#include <wavreader.h>
+#include <utils/iq_reader.h>
 #include <core.h>
 #include <gui/widgets/file_select.h>
+#include <gui/style.h>
 #include <filesystem>
 #include <regex>
 #include <gui/tuner.h>
 #include <algorithm>
 #include <stdexcept>
+#include <dsp/convert/iq.h>
+#include <chrono>
+#include <atomic>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
+// Fall further behind than this and the pacing starts over instead of catching up in a burst
+#define MAX_PACING_LAG          0.1
+#define FAST_MODE_BLOCK_SIZE    65536
+
 SDRPP_MOD_INFO{
     /* Name:            */ "file_source",
     /* Description:     */ "Wav file source module for SDR++",
     /* Author:          */ "Ryzerth",
-    /* Version:         */ 0, 1, 1,
+    /* Version:         */ 0, 2, 0,
     /* Max instances    */ 1
 };
 
@@ -27,13 +35,15 @@ ConfigManager config;
 
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "IQ Files (*.wav *.w64 *.sigmf-data *.sigmf-meta)", "*.wav *.w64 *.sigmf-data *.sigmf-meta", "All Files", "*" }) {
         this->name = name;
 
         if (core::args["server"].b()) { return; }
 
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        if (config.conf.contains("fastMode")) { fastMode = config.conf["fastMode"]; }
+        if (config.conf.contains("loop")) { loop = config.conf["loop"]; }
         config.release();
 
         handler.ctx = this;
@@ -92,7 +102,8 @@ private:
         if (_this->running) { return; }
         if (_this->reader == NULL) { return; }
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->stopWorker = false;
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
@@ -100,11 +111,11 @@ private:
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (!_this->running) { return; }
         if (_this->reader == NULL) { return; }
+        _this->stopWorker = true;
         _this->stream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
         _this->running = false;
-        _this->reader->rewind();
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -118,22 +129,23 @@ private:
 
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
+                // The worker reads straight from the mapped file and uses the converter, stop it before replacing them
+                bool wasRunning = _this->running;
+                stop(_this);
                 if (_this->reader != NULL) {
                     _this->reader->close();
                     delete _this->reader;
+                    _this->reader = NULL;
                 }
                 try {
-                    _this->reader = new WavReader(_this->fileSelect.path);
-                    if (_this->reader->getSampleRate() == 0) {
-                        _this->reader->close();
-                        delete _this->reader;
-                        _this->reader = NULL;
-                        throw std::runtime_error("Sample rate may not be zero");
-                    }
+                    _this->reader = new IQReader(_this->fileSelect.path);
                     _this->sampleRate = _this->reader->getSampleRate();
+                    _this->position = 0;
+                    _this->seekTarget = -1;
+                    if (!_this->reader->isFloat()) { _this->conv.init(_this->reader->getFormat()); }
                     core::setInputSampleRate(_this->sampleRate);
                     std::string filename = std::filesystem::path(_this->fileSelect.path).filename().string();
-                    _this->centerFreq = _this->getFrequency(filename);
+                    _this->centerFreq = _this->reader->getFrequency() ? _this->reader->getFrequency() : _this->getFrequency(filename);
                     tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
                     //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
                     //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
@@ -142,42 +154,110 @@ private:
                 catch (const std::exception& e) {
                     flog::error("Error: {}", e.what());
                 }
+                if (wasRunning) { start(_this); }
                 config.acquire();
                 config.conf["path"] = _this->fileSelect.path;
                 config.release(true);
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+        if (_this->reader) {
+            // Seek bar
+            double duration = (double)_this->reader->getSampleCount() / _this->sampleRate;
+            float pos = (double)_this->position / _this->sampleRate;
+            ImGui::FillWidth();
+            if (ImGui::SliderFloat("##_file_source_pos", &pos, 0.0f, duration, formatTime(pos).c_str())) {
+                _this->seekTarget = std::clamp<int64_t>((double)pos * _this->sampleRate, 0, _this->reader->getSampleCount() - 1);
+                if (!_this->running) { _this->position = _this->seekTarget.exchange(-1); }
+            }
+            ImGui::Text("Length: %s", formatTime(duration).c_str());
+        }
+
+        if (ImGui::Checkbox("As fast as possible##_file_source", &_this->fastMode)) {
+            config.acquire();
+            config.conf["fastMode"] = _this->fastMode;
+            config.release(true);
+        }
+        if (ImGui::Checkbox("Loop##_file_source", &_this->loop)) {
+            config.acquire();
+            config.conf["loop"] = _this->loop;
+            config.release(true);
+        }
+    }
+
+    static std::string formatTime(double seconds) {
+        char buf[64];
+        int s = seconds;
+        sprintf(buf, "%02d:%02d:%02d", s / 3600, (s / 60) % 60, s % 60);
+        return buf;
     }
 
     static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
+        IQReader* reader = _this->reader;
+        double sampleRate = reader->getSampleRate();
+        uint64_t count = reader->getSampleCount();
+        int sampleSize = reader->getSampleSize();
+        int blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+        uint64_t pos = std::min<uint64_t>(_this->position, count - 1);
+
+        // Samples are paced against the clock from when playback (re)started
+        auto start = std::chrono::steady_clock::now();
+        uint64_t sent = 0;
+        bool wasFast = true;
 
         while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
-        }
+            // Jump to the requested position
+            int64_t target = _this->seekTarget.exchange(-1);
+            if (target >= 0) {
+                pos = std::min<uint64_t>(target, count - 1);
+                wasFast = true;
+            }
 
-        delete[] inBuf;
-    }
+            // Wait for a seek or to be stopped once the end is reached, unless looping
+            if (pos >= count) {
+                if (!_this->loop) {
+                    if (_this->stopWorker) { break; }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    wasFast = true;
+                    continue;
+                }
+                pos = 0;
+            }
 
-    static void floatWorker(void* ctx) {
-        FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
+            // Restart the pacing when coming back to real time
+            bool fast = _this->fastMode;
+            if (!fast && wasFast) {
+                start = std::chrono::steady_clock::now();
+                sent = 0;
+            }
+            wasFast = fast;
 
-        while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
-            if (!_this->stream.swap(blockSize)) { break; };
+            // Convert directly from the mapped file into the stream
+            int n = std::min<uint64_t>(fast ? FAST_MODE_BLOCK_SIZE : blockSize, count - pos);
+            const uint8_t* data = &reader->samples()[pos * sampleSize];
+            if (reader->isFloat()) {
+                memcpy(_this->stream.writeBuf, data, n * sizeof(dsp::complex_t));
+            }
+            else {
+                _this->conv.process(n, data, _this->stream.writeBuf);
+            }
+            if (!_this->stream.swap(n)) { break; }
+            pos += n;
+            _this->position = pos;
+
+            // In fast mode, the consumers set the pace
+            if (fast) { continue; }
+            sent += n;
+            auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double)sent / sampleRate));
+            auto now = std::chrono::steady_clock::now();
+            if (now - deadline > std::chrono::duration<double>(MAX_PACING_LAG)) {
+                start = now;
+                sent = 0;
+                continue;
+            }
+            std::this_thread::sleep_until(deadline);
         }
-
-        delete[] inBuf;
     }
 
     double getFrequency(std::string filename) {
@@ -192,8 +272,9 @@ private:
     FileSelect fileSelect;
     std::string name;
     dsp::stream<dsp::complex_t> stream;
+    dsp::convert::IQConverter conv = dsp::convert::IQConverter(dsp::convert::IQ_FORMAT_I16);
     SourceManager::SourceHandler handler;
-    WavReader* reader = NULL;
+    IQReader* reader = NULL;
     bool running = false;
     bool enabled = true;
     float sampleRate = 1000000;
@@ -201,12 +282,18 @@ private:
 
     double centerFreq = 100000000;
 
-    bool float32Mode = false;
+    bool fastMode = false;
+    bool loop = true;
+    std::atomic<bool> stopWorker = false;
+    std::atomic<uint64_t> position = 0;
+    std::atomic<int64_t> seekTarget = -1;
 };
 
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["fastMode"] = false;
+    def["loop"] = true;
     config.setPath(core::args["root"].s() + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
@@ -7,6 +7,7 @@
 #include <config.h>
 #include <gui/widgets/stepped_slider.h>
 #include <gui/smgui.h>
+#include <dsp/convert/iq.h>
 
 #ifndef __ANDROID__
 #include <libhackrf/hackrf.h>
@@ -382,7 +383,7 @@ private:
 
     static int callback(hackrf_transfer* transfer) {
         HackRFSourceModule* _this = (HackRFSourceModule*)transfer->rx_ctx;
-        volk_8i_s32f_convert_32f((float*)_this->stream.writeBuf, (int8_t*)transfer->buffer, 128.0f, transfer->valid_length);
+        _this->conv.process(transfer->valid_length / 2, transfer->buffer, _this->stream.writeBuf);
         if (!_this->stream.swap(transfer->valid_length / 2)) { return -1; }
         return 0;
     }
@@ -391,6 +392,7 @@ private:
     hackrf_device* openDev;
     bool enabled = true;
     dsp::stream<dsp::complex_t> stream;
+    dsp::convert::IQConverter conv = dsp::convert::IQConverter(dsp::convert::IQ_FORMAT_I8);
     int sampleRate;
     SourceManager::SourceHandler handler;
     bool running = false;
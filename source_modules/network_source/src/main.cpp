@@ -9,6 +9,7 @@
 #include <gui/smgui.h>
 #include <gui/widgets/stepped_slider.h>
 #include <utils/optionlist.h>
+#include <dsp/convert/iq.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
@@ -282,6 +283,11 @@ private:
         int sampleSize = SAMPLE_TYPE_SIZE[sampType];
         int frameSize = blockSize*sampleSize;
 
+        // Select the converter
+        if (sampType == SAMPLE_TYPE_INT8) { conv.init(dsp::convert::IQ_FORMAT_I8); }
+        else if (sampType == SAMPLE_TYPE_INT16) { conv.init(dsp::convert::IQ_FORMAT_I16); }
+        else if (sampType == SAMPLE_TYPE_INT32) { conv.init(dsp::convert::IQ_FORMAT_I32); }
+
         // Allocate receive buffer
         uint8_t* buffer = dsp::buffer::alloc<uint8_t>(frameSize);
 
@@ -292,21 +298,11 @@ private:
 
             // Convert to CF32 (note: problem if partial sample)
             int count = bytes / sampleSize;
-            switch (sampType) {
-            case SAMPLE_TYPE_INT8:
-                volk_8i_s32f_convert_32f((float*)stream.writeBuf, (int8_t*)buffer, 128.0f, count*2);
-                break;
-            case SAMPLE_TYPE_INT16:
-                volk_16i_s32f_convert_32f((float*)stream.writeBuf, (int16_t*)buffer, 32768.0f, count*2);
-                break;
-            case SAMPLE_TYPE_INT32:
-                volk_32i_s32f_convert_32f((float*)stream.writeBuf, (int32_t*)buffer, 2147483647.0f, count*2);
-                break;
-            case SAMPLE_TYPE_FLOAT32:
+            if (sampType == SAMPLE_TYPE_FLOAT32) {
                 memcpy(stream.writeBuf, buffer, bytes);
-                break;
-            default:
-                break;
+            }
+            else {
+                conv.process(count, buffer, stream.writeBuf);
             }
 
             // Send out converted samples
@@ -329,6 +325,7 @@ private:
     Protocol proto = PROTOCOL_UDP;
     int protoId;
     SampleType sampType = SAMPLE_TYPE_INT16;
+    dsp::convert::IQConverter conv;
     int sampTypeId;
     char hostname[1024] = "localhost";
     int port = 1234;
@@ -7,6 +7,7 @@
 #include <config.h>
 #include <gui/smgui.h>
 #include <rtl-sdr.h>
+#include <dsp/convert/iq.h>
 
 #ifdef __ANDROID__
 #include <android_backend.h>
@@ -63,6 +64,10 @@ public:
 
         sampleRate = sampleRates[0];
 
+        // The dongles' DC offset is slightly below the center of the range
+        conv.init(dsp::convert::IQ_FORMAT_U8);
+        conv.setOffset(127.4f);
+
         handler.ctx = this;
         handler.selectHandler = menuSelected;
         handler.deselectHandler = menuDeselected;
@@ -522,10 +527,7 @@ private:
     static void asyncHandler(unsigned char* buf, uint32_t len, void* ctx) {
         RTLSDRSourceModule* _this = (RTLSDRSourceModule*)ctx;
         int sampCount = len / 2;
-        for (int i = 0; i < sampCount; i++) {
-            _this->stream.writeBuf[i].re = ((float)buf[i * 2] - 127.4) / 128.0f;
-            _this->stream.writeBuf[i].im = ((float)buf[(i * 2) + 1] - 127.4) / 128.0f;
-        }
+        _this->conv.process(sampCount, buf, _this->stream.writeBuf);
         if (!_this->stream.swap(sampCount)) { return; }
     }
 
@@ -537,6 +539,7 @@ private:
     rtlsdr_dev_t* openDev;
     bool enabled = true;
     dsp::stream<dsp::complex_t> stream;
+    dsp::convert::IQConverter conv;
     double sampleRate;
     SourceManager::SourceHandler handler;
     bool running = false;
@@ -2,6 +2,7 @@
 #include <utils/net.h>
 #include <dsp/stream.h>
 #include <dsp/types.h>
+#include <dsp/convert/iq.h>
 #include <thread>
 
 namespace rtltcp {
@@ -38,6 +39,7 @@ namespace rtltcp {
         std::shared_ptr<net::Socket> sock;
         std::thread workerThread;
         dsp::stream<dsp::complex_t>* stream;
+        dsp::convert::IQConverter conv = dsp::convert::IQConverter(dsp::convert::IQ_FORMAT_U8);
         int bufferSize = 2400000 / 200;
     };
 
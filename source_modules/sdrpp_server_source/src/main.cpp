@@ -36,6 +36,11 @@ public:
         sampleTypeList.define("Int16", dsp::compression::PCM_TYPE_I16);
         sampleTypeList.define("Float32", dsp::compression::PCM_TYPE_F32);
         sampleTypeId = sampleTypeList.valueId(dsp::compression::PCM_TYPE_I16);
+        const double narrowbandRates[] = { 1000000.0, 500000.0, 250000.0, 100000.0, 50000.0, 25000.0 };
+        for (double sr : narrowbandRates) {
+            narrowbandRateList.define(getBandwdithScaled(sr), sr);
+        }
+        narrowbandRateId = narrowbandRateList.valueId(250000.0);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -179,6 +184,21 @@ private:
 
 
         if (connected) {
+            if (ImGui::Checkbox("Adapt to link speed", &_this->adaptive)) {
+                // Going back to manual mode restores the selected format
+                if (!_this->adaptive) {
+                    _this->client->setSampleType(_this->sampleTypeList[_this->sampleTypeId]);
+                    _this->client->setCompression(_this->compression);
+                }
+                _this->client->setAdaptive(_this->adaptive);
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["adaptive"] = _this->adaptive;
+                config.release(true);
+            }
+
+            if (_this->adaptive) { style::beginDisabled(); }
             ImGui::LeftLabel("Sample type");
             ImGui::FillWidth();
             if (ImGui::Combo("##sdrpp_srv_source_samp_type", &_this->sampleTypeId, _this->sampleTypeList.txt)) {
@@ -198,11 +218,31 @@ private:
                 config.conf["servers"][_this->devConfName]["compression"] = _this->compression;
                 config.release(true);
             }
+            if (_this->adaptive) { style::endDisabled(); }
 
-            bool dummy = true;
-            style::beginDisabled();
-            ImGui::Checkbox("Full IQ", &dummy);
-            style::endDisabled();
+            // Without full IQ, the server only sends a channel of the selected samplerate at the tuned frequency
+            if (_this->running) { style::beginDisabled(); }
+            if (ImGui::Checkbox("Full IQ", &_this->fullIQ)) {
+                _this->applyNarrowband();
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["fullIQ"] = _this->fullIQ;
+                config.release(true);
+            }
+            if (!_this->fullIQ) {
+                ImGui::LeftLabel("Samplerate");
+                ImGui::FillWidth();
+                if (ImGui::Combo("##sdrpp_srv_source_nb_sr", &_this->narrowbandRateId, _this->narrowbandRateList.txt)) {
+                    _this->applyNarrowband();
+
+                    // Save config
+                    config.acquire();
+                    config.conf["servers"][_this->devConfName]["narrowbandSampleRate"] = _this->narrowbandRateList.key(_this->narrowbandRateId);
+                    config.release(true);
+                }
+            }
+            if (_this->running) { style::endDisabled(); }
 
             // Calculate datarate
             _this->frametimeCounter += ImGui::GetIO().DeltaTime;
@@ -216,6 +256,23 @@ private:
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected (%.3f Mbit/s)", _this->datarate);
 
+            // Show what the server is actually sending
+            server::StreamStatus status;
+            if (_this->client->getStreamStatus(status)) {
+                const char* typeName = (status.pcmType == dsp::compression::PCM_TYPE_I8) ? "Int8" : (status.pcmType == dsp::compression::PCM_TYPE_I16) ? "Int16" : "Float32";
+                if (status.compressionLevel) {
+                    ImGui::Text("Format: %s, zstd level %d", typeName, status.compressionLevel);
+                }
+                else {
+                    ImGui::Text("Format: %s, uncompressed", typeName);
+                }
+                ImGui::Text("Link: %.3f Mbit/s, %.0f%% busy", status.sendRate * 8.0 / (1024.0 * 1024.0), status.linkBusy * 100.0);
+                bool late = (status.queued > 1 || status.dropped);
+                if (late) { ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.5f, 0.0f, 1.0f)); }
+                ImGui::Text("Queued: %d, Dropped: %llu", (int)status.queued, (unsigned long long)status.dropped);
+                if (late) { ImGui::PopStyleColor(); }
+            }
+
             ImGui::CollapsingHeader("Source [REMOTE]", ImGuiTreeNodeFlags_DefaultOpen);
 
             _this->client->showMenu();
@@ -258,10 +315,30 @@ private:
         if (config.conf["servers"][devConfName].contains("compression")) {
             compression = config.conf["servers"][devConfName]["compression"];
         }
+        adaptive = false;
+        if (config.conf["servers"][devConfName].contains("adaptive")) {
+            adaptive = config.conf["servers"][devConfName]["adaptive"];
+        }
+        fullIQ = true;
+        if (config.conf["servers"][devConfName].contains("fullIQ")) {
+            fullIQ = config.conf["servers"][devConfName]["fullIQ"];
+        }
+        narrowbandRateId = narrowbandRateList.valueId(250000.0);
+        if (config.conf["servers"][devConfName].contains("narrowbandSampleRate")) {
+            std::string key = config.conf["servers"][devConfName]["narrowbandSampleRate"];
+            if (narrowbandRateList.keyExists(key)) { narrowbandRateId = narrowbandRateList.keyId(key); }
+        }
 
-        // Set settings
+        // Set settings, the adaptive mode starts from the selected format
         client->setSampleType(sampleTypeList[sampleTypeId]);
         client->setCompression(compression);
+        if (adaptive) { client->setAdaptive(true); }
+        applyNarrowband();
+    }
+
+    void applyNarrowband() {
+        client->setNarrowband(fullIQ ? 0.0 : narrowbandRateList[narrowbandRateId]);
+        core::setInputSampleRate(client->getSampleRate());
     }
 
     std::string name;
@@ -284,6 +361,11 @@ private:
     OptionList<std::string, dsp::compression::PCMType> sampleTypeList;
     int sampleTypeId;
     bool compression = false;
+    bool adaptive = false;
+
+    bool fullIQ = true;
+    OptionList<std::string, double> narrowbandRateList;
+    int narrowbandRateId;
 
     std::shared_ptr<server::Client> client;
 };
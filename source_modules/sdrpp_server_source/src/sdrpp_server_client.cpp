@@ -27,7 +27,7 @@ namespace server {
         s_cmd_data = &sbuffer[sizeof(PacketHeader) + sizeof(CommandHeader)];
 
         // Initialize decompressor
-        dctx = ZSTD_createDCtx();
+        decompressor = new dsp::compression::ChunkedDecompressor(std::clamp<int>(std::thread::hardware_concurrency(), 1, MAX_DECOMPRESSION_THREADS));
 
         // Initialize DSP
         decompIn.setBufferSize(STREAM_BUFFER_SIZE*sizeof(dsp::complex_t) + 8);
@@ -48,7 +48,7 @@ namespace server {
 
     Client::~Client() {
         close();
-        ZSTD_freeDCtx(dctx);
+        delete decompressor;
         delete[] rbuffer;
         delete[] sbuffer;
     }
@@ -106,7 +106,7 @@ namespace server {
     }
 
     double Client::getSampleRate() {
-        return currentSampleRate;
+        return (narrowbandSampleRate > 0.0) ? narrowbandSampleRate : currentSampleRate;
     }
 
     void Client::setSampleType(dsp::compression::PCMType type) {
@@ -121,18 +121,73 @@ namespace server {
         sendCommand(COMMAND_SET_COMPRESSION, 1);
     }
 
+    void Client::setAdaptive(bool enabled) {
+        if (!isOpen()) { return; }
+        s_cmd_data[0] = enabled;
+        sendCommand(COMMAND_SET_ADAPTIVE, 1);
+    }
+
+    bool Client::getStreamStatus(StreamStatus& status) {
+        std::lock_guard<std::mutex> lck(streamStatusMtx);
+        status = streamStatus;
+        return streamStatusValid;
+    }
+
     void Client::start() {
         if (!isOpen()) { return; }
-        sendCommand(COMMAND_START, 0);
+
+        // The server can only decimate
+        if (narrowbandSampleRate > currentSampleRate) {
+            flog::error("The narrowband samplerate is higher than the samplerate of the server");
+            return;
+        }
+
+        streamingSampleRate = narrowbandSampleRate;
+        if (streamingSampleRate > 0.0) {
+            setVFO(NARROWBAND_VFO_ID, 0.0, streamingSampleRate, streamingSampleRate);
+        }
+        else {
+            sendCommand(COMMAND_START, 0);
+        }
         getUI();
     }
 
     void Client::stop() {
         if (!isOpen()) { return; }
-        sendCommand(COMMAND_STOP, 0);
+        if (streamingSampleRate > 0.0) {
+            removeVFO(NARROWBAND_VFO_ID);
+        }
+        else {
+            sendCommand(COMMAND_STOP, 0);
+        }
+        streamingSampleRate = 0.0;
         getUI();
     }
 
+    void Client::setNarrowband(double sampleRate) {
+        narrowbandSampleRate = sampleRate;
+    }
+
+    void Client::setVFO(uint8_t id, double offset, double bandwidth, double sampleRate) {
+        if (!isOpen()) { return; }
+        VFOConfig config;
+        config.id = id;
+        config.offset = offset;
+        config.bandwidth = bandwidth;
+        config.sampleRate = sampleRate;
+        memcpy(s_cmd_data, &config, sizeof(VFOConfig));
+        auto waiter = awaitCommandAck(COMMAND_SET_VFO);
+        sendCommand(COMMAND_SET_VFO, sizeof(VFOConfig));
+        waiter->await(PROTOCOL_TIMEOUT_MS);
+        waiter->handled();
+    }
+
+    void Client::removeVFO(uint8_t id) {
+        if (!isOpen()) { return; }
+        s_cmd_data[0] = id;
+        sendCommand(COMMAND_REMOVE_VFO, 1);
+    }
+
     void Client::close() {
         // Stop worker
         decompIn.stopWriter();
@@ -168,8 +223,14 @@ namespace server {
             if (r_pkt_hdr->type == PACKET_TYPE_COMMAND) {
                 // TODO: Move to command handler
                 if (r_cmd_hdr->cmd == COMMAND_SET_SAMPLERATE && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(double)) {
+                    // In narrowband mode the input samplerate is the one of the channel, not of the server
                     currentSampleRate = *(double*)r_cmd_data;
-                    core::setInputSampleRate(currentSampleRate);
+                    if (narrowbandSampleRate <= 0.0) { core::setInputSampleRate(currentSampleRate); }
+                }
+                else if (r_cmd_hdr->cmd == COMMAND_STREAM_STATUS && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(StreamStatus)) {
+                    std::lock_guard<std::mutex> lck(streamStatusMtx);
+                    memcpy(&streamStatus, r_cmd_data, sizeof(StreamStatus));
+                    streamStatusValid = true;
                 }
                 else if (r_cmd_hdr->cmd == COMMAND_DISCONNECT) {
                     flog::error("Asked to disconnect by the server");
@@ -209,11 +270,27 @@ namespace server {
                 if (!decompIn.swap(r_pkt_hdr->size - sizeof(PacketHeader))) { break; }
             }
             else if (r_pkt_hdr->type == PACKET_TYPE_BASEBAND_COMPRESSED) {
-                size_t outCount = ZSTD_decompressDCtx(dctx, decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader));
-                if (outCount) {
+                size_t outCount = decompressor->decompress(decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, r_pkt_data, r_pkt_hdr->size - sizeof(PacketHeader));
+                if (!ZSTD_isError(outCount) && outCount) {
                     if (!decompIn.swap(outCount)) { break; }
                 };
             }
+            else if (r_pkt_hdr->type == PACKET_TYPE_VFO && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(VFOHeader) + 8) {
+                // The channel is encoded like the baseband and takes its place in the output stream
+                VFOHeader* vhdr = (VFOHeader*)r_pkt_data;
+                if (vhdr->id != NARROWBAND_VFO_ID || streamingSampleRate <= 0.0) { continue; }
+                uint8_t* data = &r_pkt_data[sizeof(VFOHeader)];
+                int size = r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(VFOHeader);
+                if (vhdr->compressed) {
+                    size_t outCount = decompressor->decompress(decompIn.writeBuf, STREAM_BUFFER_SIZE*sizeof(dsp::complex_t)+8, data, size);
+                    if (ZSTD_isError(outCount) || outCount < 8) { continue; }
+                    size = outCount;
+                }
+                else {
+                    memcpy(decompIn.writeBuf, data, size);
+                }
+                if (!decompIn.swap(size)) { break; }
+            }
             else if (r_pkt_hdr->type == PACKET_TYPE_ERROR) {
                 flog::error("SDR++ Server Error: {0}", rbuffer[sizeof(PacketHeader)]);
             }
@@ -9,11 +9,16 @@
 #include <map>
 #include <vector>
 #include <dsp/compression/sample_stream_decompressor.h>
+#include <dsp/compression/zstd_chunked.h>
 #include <dsp/sink.h>
 #include <dsp/routing/stream_link.h>
 #include <zstd.h>
 
 #define PROTOCOL_TIMEOUT_MS             10000
+#define MAX_DECOMPRESSION_THREADS       4
+
+// Id of the server-side VFO used in narrowband mode
+#define NARROWBAND_VFO_ID               0
 
 namespace server {
     class PacketWaiter {
@@ -83,10 +88,18 @@ namespace server {
         
         void setSampleType(dsp::compression::PCMType type);
         void setCompression(bool enabled);
+        void setAdaptive(bool enabled);
+
+        // Last stream status reported by the server, returns false if none was received yet
+        bool getStreamStatus(StreamStatus& status);
 
         void start();
         void stop();
 
+        // Stream a channel of that samplerate centered on the tuned frequency, extracted by the server, instead of
+        // the whole baseband. 0 goes back to the baseband. Only takes effect on the next start.
+        void setNarrowband(double sampleRate);
+
         void close();
         bool isOpen();
 
@@ -98,6 +111,9 @@ namespace server {
 
         int getUI();
 
+        void setVFO(uint8_t id, double offset, double bandwidth, double sampleRate);
+        void removeVFO(uint8_t id);
+
         void sendPacket(PacketType type, int len);
         void sendCommand(Command cmd, int len);
         void sendCommandAck(Command cmd, int len);
@@ -131,11 +147,17 @@ namespace server {
         SmGui::DrawList dl;
         std::mutex dlMtx;
 
-        ZSTD_DCtx* dctx;
+        dsp::compression::ChunkedDecompressor* decompressor = NULL;
 
         std::thread workerThread;
 
         double currentSampleRate = 1000000.0;
+        double narrowbandSampleRate = 0.0;
+        double streamingSampleRate = 0.0;
+
+        StreamStatus streamStatus;
+        bool streamStatusValid = false;
+        std::mutex streamStatusMtx;
     };
 
     std::shared_ptr<Client> connect(std::string host, uint16_t port, dsp::stream<dsp::complex_t>* out);
@@ -0,0 +1,37 @@
+#include "bench.h"
+#include <new>
+
+namespace bench {
+    std::atomic<uint64_t> allocCount = 0;
+}
+
+// Count every allocation done through operator new, volk and fftw allocations aren't counted
+void* operator new(size_t size) {
+    bench::allocCount++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    bench::allocCount++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept {
+    free(ptr);
+}
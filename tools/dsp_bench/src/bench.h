@@ -0,0 +1,100 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <stdlib.h>
+#include <math.h>
+#include <dsp/stream.h>
+#include <dsp/bench/speed_tester.h>
+
+namespace bench {
+    struct Result {
+        std::string name;
+        std::string mode;
+        double samplerate;
+        double nsPerSample;
+        uint64_t allocations;
+        double maxError = NAN;  // Only for cases that check their accuracy
+    };
+
+    struct Case {
+        std::string name;
+        std::function<Result(int durationMs, int bufferSize)> process;
+        std::function<Result(int durationMs, int bufferSize)> threaded;
+    };
+
+    // Number of calls to operator new since the start of the program, see alloc_counter.cpp
+    extern std::atomic<uint64_t> allocCount;
+
+    std::vector<Case>& cases();
+
+    // Defined in cases.cpp
+    void registerCases();
+
+    template <class T>
+    inline void fillRandom(T* buf, int count) {
+        float* fbuf = (float*)buf;
+        int fcount = count * (sizeof(T) / sizeof(float));
+        for (int i = 0; i < fcount; i++) {
+            fbuf[i] = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+        }
+    }
+
+    // Registers a block. init(block, in) initializes the block with a given input, which is NULL when
+    // process() is called directly, and process(block, count, in, out) calls the block's process function.
+    template <class I, class O, class BLOCK, class Init, class Process>
+    void add(const std::string& name, Init init, Process process) {
+        Case c;
+        c.name = name;
+
+        c.process = [=](int durationMs, int bufferSize) {
+            BLOCK block;
+            init(block, (dsp::stream<I>*)NULL);
+
+            // Allocate input with random samples and enough output for any of the blocks
+            I* in = dsp::buffer::alloc<I>(bufferSize);
+            O* out = dsp::buffer::alloc<O>(STREAM_BUFFER_SIZE);
+            fillRandom(in, bufferSize);
+
+            // Run the block for the requested duration
+            uint64_t samples = 0;
+            uint64_t allocs = allocCount;
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::milliseconds(durationMs);
+            auto now = start;
+            while (now < end) {
+                process(block, bufferSize, in, out);
+                samples += bufferSize;
+                now = std::chrono::steady_clock::now();
+            }
+            allocs = allocCount - allocs;
+            double seconds = std::chrono::duration<double>(now - start).count();
+
+            dsp::buffer::free(in);
+            dsp::buffer::free(out);
+
+            double rate = (double)samples / seconds;
+            return Result{ name, "process", rate, 1e9 / rate, allocs };
+        };
+
+        c.threaded = [=](int durationMs, int bufferSize) {
+            dsp::stream<I> in;
+            BLOCK block;
+            init(block, &in);
+
+            // Push samples through the block's thread with a writer and reader thread on both ends
+            dsp::bench::SpeedTester<I, O> tester(&in, &block.out);
+            block.start();
+            uint64_t allocs = allocCount;
+            double rate = tester.benchmark(durationMs, bufferSize);
+            allocs = allocCount - allocs;
+            block.stop();
+
+            return Result{ name, "threaded", rate, 1e9 / rate, allocs };
+        };
+
+        cases().push_back(c);
+    }
+}
@@ -0,0 +1,444 @@
+#include "bench.h"
+#include <dsp/filter/fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/multirate/polyphase_resampler.h>
+#include <dsp/demod/quadrature.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/loop/agc.h>
+#include <dsp/loop/costas.h>
+#include <dsp/loop/carrier_tracking_pll.h>
+#include <dsp/math/phasor.h>
+#include <dsp/math/nco.h>
+#include <dsp/math/normalize_phase.h>
+#include <dsp/clock_recovery/mm.h>
+#include <dsp/noise_reduction/fm_if.h>
+#include <dsp/noise_reduction/fft_fm_if.h>
+#include <dsp/noise_reduction/noise_blanker.h>
+#include <dsp/taps/low_pass.h>
+#include <dsp/taps/from_array.h>
+#include <dsp/channel/channelizer_vfo.h>
+#include <dsp/routing/splitter.h>
+#include <dsp/ring_stream.h>
+#include <dsp/sink/null_sink.h>
+#include <memory>
+
+using namespace dsp;
+
+namespace bench {
+    std::vector<Case>& cases() {
+        static std::vector<Case> _cases;
+        return _cases;
+    }
+
+    // PowerDecimator as it was before the polyphase kernels, every stage is a DecimatingFIR. Kept as a reference.
+    class DirectPowerDecimator : public Processor<complex_t, complex_t> {
+        using base_type = Processor<complex_t, complex_t>;
+    public:
+        ~DirectPowerDecimator() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            for (auto& fir : firs) { delete fir; }
+            for (auto& taps : stageTaps) { taps::free(taps); }
+        }
+
+        void init(stream<complex_t>* in, unsigned int ratio) {
+            multirate::decim::plan plan = multirate::decim::plans[(int)log2(ratio) - 1];
+            for (int i = 0; i < plan.stageCount; i++) {
+                tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
+                auto fir = new filter::DecimatingFIR<complex_t, float>(NULL, taps, plan.stages[i].decimation);
+                fir->out.free();
+                stageTaps.push_back(taps);
+                firs.push_back(fir);
+            }
+            base_type::init(in);
+        }
+
+        inline int process(int count, const complex_t* in, complex_t* out) {
+            const complex_t* data = in;
+            for (auto& fir : firs) {
+                count = fir->process(count, data, out);
+                data = out;
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    private:
+        std::vector<filter::DecimatingFIR<complex_t, float>*> firs;
+        std::vector<tap<float>> stageTaps;
+    };
+
+    // Blocks with the kernels specialized on their tap count turned off, to compare against the generic volk path
+    template <class D, class T>
+    class GenericFIR : public filter::FIR<D, T> {
+    public:
+        void init(stream<D>* in, tap<T>& taps) {
+            filter::FIR<D, T>::init(in, taps);
+            this->fixedConvolve = NULL;
+        }
+    };
+
+    template <class D, class T>
+    class GenericDecimatingFIR : public filter::DecimatingFIR<D, T> {
+    public:
+        void init(stream<D>* in, tap<T>& taps, int decimation) {
+            filter::DecimatingFIR<D, T>::init(in, taps, decimation);
+            this->fixedConvolve = NULL;
+        }
+    };
+
+    template <class T>
+    class GenericPolyphaseResampler : public multirate::PolyphaseResampler<T> {
+    public:
+        void init(stream<T>* in, int interp, int decim, tap<float> taps) {
+            multirate::PolyphaseResampler<T>::init(in, interp, decim, taps);
+            this->kernel = &GenericPolyphaseResampler::template resample<0>;
+        }
+    };
+
+    template <class T>
+    class GenericMM : public clock_recovery::MM<T> {
+    public:
+        void init(stream<T>* in, double omega, double omegaGain, double muGain, double omegaRelLimit) {
+            clock_recovery::MM<T>::init(in, omega, omegaGain, muGain, omegaRelLimit);
+            this->kernel = &GenericMM::template recover<0>;
+        }
+    };
+
+    // Registers an oscillator, timed as a loop would use it (each phase depends on the previous output) and
+    // checked against double precision sin/cos over the whole circle
+    template <class Func>
+    void addPhasor(const std::string& name, Func func) {
+        std::string caseName = "Phasor/" + name;
+        Case c;
+        c.name = caseName;
+        c.process = [=](int durationMs, int bufferSize) {
+            complex_t* out = dsp::buffer::alloc<complex_t>(bufferSize);
+            float phase = 0.0f;
+            uint64_t samples = 0;
+            uint64_t allocs = allocCount;
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::milliseconds(durationMs);
+            auto now = start;
+            while (now < end) {
+                for (int i = 0; i < bufferSize; i++) {
+                    out[i] = func(phase);
+                    phase = math::normalizePhase(phase + 0.1f + (1e-3f * out[i].im));
+                }
+                samples += bufferSize;
+                now = std::chrono::steady_clock::now();
+            }
+            allocs = allocCount - allocs;
+            double seconds = std::chrono::duration<double>(now - start).count();
+            dsp::buffer::free(out);
+
+            double maxError = 0.0;
+            for (int i = 0; i <= 1000000; i++) {
+                float p = (float)(-DB_M_PI + (2.0 * DB_M_PI * (double)i / 1000000.0));
+                complex_t v = func(p);
+                maxError = std::max<double>(maxError, fabs((double)v.re - cos((double)p)));
+                maxError = std::max<double>(maxError, fabs((double)v.im - sin((double)p)));
+            }
+
+            double rate = (double)samples / seconds;
+            Result r = { caseName, "process", rate, 1e9 / rate, allocs };
+            r.maxError = maxError;
+            return r;
+        };
+        cases().push_back(c);
+    }
+
+    // A channelized VFO retuned onto a tone and then given a new bandwidth, which also changes its input samplerate.
+    // The blocks are run by hand in a single thread. The max error is the frequency of the output in Hz,
+    // the tone must end up at DC.
+    void addChannelizerVFO() {
+        std::string caseName = "ChannelizerVFO/retune";
+        Case c;
+        c.name = caseName;
+        c.process = [=](int durationMs, int bufferSize) {
+            const double samplerate = 1000000.0;
+            const double toneFreq = 150000.0;
+            const double outSamplerate = 50000.0;
+            stream<complex_t> in;
+            channel::Channelizer channelizer(&in, samplerate);
+            channel::ChannelizerVFO vfo(&channelizer, outSamplerate, 20000.0, 0.0);
+            vfo.setOffset(toneFreq);
+            vfo.setBandwidth(30000.0);
+
+            // Whole FFT hops so that every input produces an output
+            const int blockSize = CHANNELIZER_DEFAULT_FFT_SIZE;
+            lv_32fc_t phase = lv_cmake(1.0f, 0.0f);
+            lv_32fc_t phaseDelta = lv_cmake(cos(math::hzToRads(toneFreq, samplerate)), sin(math::hzToRads(toneFreq, samplerate)));
+            std::vector<complex_t> ones(blockSize, complex_t{ 1.0f, 0.0f });
+
+            uint64_t samples = 0;
+            uint64_t allocs = allocCount;
+            double phaseSum = 0.0;
+            uint64_t phaseCount = 0;
+            complex_t last = { 0.0f, 0.0f };
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::milliseconds(durationMs);
+            auto now = start;
+            for (int iter = 0; now < end || iter < 50; iter++) {
+                volk_32fc_s32fc_x2_rotator_32fc((lv_32fc_t*)in.writeBuf, (lv_32fc_t*)ones.data(), phaseDelta, &phase, blockSize);
+                in.swap(blockSize);
+                channelizer.run();
+                vfo.run();
+                int count = vfo.out.read();
+
+                // Skip the filter transients
+                for (int i = 0; i < count && iter >= 10; i++) {
+                    phaseSum += (vfo.out.readBuf[i] * last.conj()).phase();
+                    phaseCount++;
+                    last = vfo.out.readBuf[i];
+                }
+                if (count) { last = vfo.out.readBuf[count - 1]; }
+                vfo.out.flush();
+
+                samples += blockSize;
+                now = std::chrono::steady_clock::now();
+            }
+            allocs = allocCount - allocs;
+            double seconds = std::chrono::duration<double>(now - start).count();
+
+            double rate = (double)samples / seconds;
+            Result r = { caseName, "process", rate, 1e9 / rate, allocs };
+            r.maxError = fabs(phaseSum / (double)phaseCount) * outSamplerate / (2.0 * DB_M_PI);
+            return r;
+        };
+        cases().push_back(c);
+    }
+
+    // A shared splitter feeding a few filters the way IQFrontEnd feeds its VFOs, with the filter inputs either
+    // double buffered or ring backed. Only runs through the block threads since it measures the hand off.
+    template <class STREAM>
+    void addSplitter(const std::string& type) {
+        std::string caseName = "Splitter/shared/" + type;
+        Case c;
+        c.name = caseName;
+        c.threaded = [=](int durationMs, int bufferSize) {
+            const int branchCount = 4;
+            tap<float> taps = taps::lowPass(50000.0, 25000.0, 1000000.0);
+            complex_t* randBuf = dsp::buffer::alloc<complex_t>(bufferSize);
+            fillRandom(randBuf, bufferSize);
+
+            stream<complex_t> in;
+            routing::Splitter<complex_t> split(&in);
+            split.setSharedBuffers(true);
+            std::vector<std::unique_ptr<STREAM>> branchIns;
+            std::vector<std::unique_ptr<filter::FIR<complex_t, float>>> firs;
+            std::vector<std::unique_ptr<sink::Null<complex_t>>> sinks;
+            for (int i = 0; i < branchCount; i++) {
+                branchIns.emplace_back(new STREAM());
+                split.bindStream(branchIns.back().get());
+                firs.emplace_back(new filter::FIR<complex_t, float>(branchIns.back().get(), taps));
+                sinks.emplace_back(new sink::Null<complex_t>());
+                sinks.back()->init(&firs.back()->out);
+            }
+            split.start();
+            for (int i = 0; i < branchCount; i++) {
+                firs[i]->start();
+                sinks[i]->start();
+            }
+
+            // Push from this thread as fast as the splitter takes it
+            uint64_t samples = 0;
+            uint64_t allocs = allocCount;
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::milliseconds(durationMs);
+            auto now = start;
+            while (now < end) {
+                memcpy(in.writeBuf, randBuf, bufferSize * sizeof(complex_t));
+                if (!in.swap(bufferSize)) { break; }
+                samples += bufferSize;
+                now = std::chrono::steady_clock::now();
+            }
+            allocs = allocCount - allocs;
+            double seconds = std::chrono::duration<double>(now - start).count();
+
+            split.stop();
+            for (int i = 0; i < branchCount; i++) {
+                firs[i]->stop();
+                sinks[i]->stop();
+            }
+            dsp::buffer::free(randBuf);
+            taps::free(taps);
+
+            double rate = (double)samples / seconds;
+            return Result{ caseName, "threaded", rate, 1e9 / rate, allocs };
+        };
+        cases().push_back(c);
+    }
+
+    // Registers FIR filters for a few tap counts, on both sides of the FFT convolution threshold
+    template <class D, class T>
+    void addFIRs(const std::string& type) {
+        const int tapCounts[] = { 31, 127, 511 };
+        for (int tc : tapCounts) {
+            tap<T> taps = taps::alloc<T>(tc);
+            fillRandom(taps.taps, tc);
+            add<D, D, filter::FIR<D, T>>("FIR<" + type + ">/" + std::to_string(tc),
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+            add<D, D, filter::DecimatingFIR<D, T>>("DecimatingFIR<" + type + ">/" + std::to_string(tc) + "/4",
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t, 4); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+        }
+    }
+
+    // Registers the small filters that have a kernel specialized on their tap count, each with its generic version
+    template <class D, class T>
+    void addSmallFIRs(const std::string& type) {
+        const int tapCounts[] = { 2, 4, 8, 10, 16 };
+        for (int tc : tapCounts) {
+            tap<T> taps = taps::alloc<T>(tc);
+            fillRandom(taps.taps, tc);
+            std::string name = "<" + type + ">/" + std::to_string(tc);
+            add<D, D, filter::FIR<D, T>>("FIR" + name,
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+            add<D, D, GenericFIR<D, T>>("FIR" + name + "/generic",
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+            add<D, D, filter::DecimatingFIR<D, T>>("DecimatingFIR" + name + "/2",
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t, 2); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+            add<D, D, GenericDecimatingFIR<D, T>>("DecimatingFIR" + name + "/2/generic",
+                [=](auto& b, auto in) { tap<T> t = taps; b.init(in, t, 2); },
+                [](auto& b, int count, D* in, D* out) { b.process(count, in, out); });
+        }
+    }
+
+    void registerCases() {
+        addFIRs<float, float>("float,float");
+        addFIRs<complex_t, float>("complex,float");
+        addFIRs<complex_t, complex_t>("complex,complex");
+        addSmallFIRs<float, float>("float,float");
+        addSmallFIRs<complex_t, float>("complex,float");
+
+        // Every ratio, with the polyphase kernels and with the previous direct form stages
+        for (unsigned int ratio = 2; ratio <= multirate::PowerDecimator<complex_t>::getMaxRatio(); ratio *= 2) {
+            add<complex_t, complex_t, multirate::PowerDecimator<complex_t>>("PowerDecimator/" + std::to_string(ratio),
+                [=](auto& b, auto in) { b.init(in, ratio); },
+                [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+            add<complex_t, complex_t, DirectPowerDecimator>("PowerDecimator/" + std::to_string(ratio) + "/direct",
+                [=](auto& b, auto in) { b.init(in, ratio); },
+                [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        }
+
+        add<complex_t, complex_t, multirate::RationalResampler<complex_t>>("RationalResampler/2.4M->48k",
+            [](auto& b, auto in) { b.init(in, 2400000.0, 48000.0); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<complex_t, complex_t, multirate::RationalResampler<complex_t>>("RationalResampler/250k->48k",
+            [](auto& b, auto in) { b.init(in, 250000.0, 48000.0); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+
+        tap<float> resampTaps = taps::lowPass(0.5 / 5.0, 0.05 / 5.0, 1.0);
+        add<complex_t, complex_t, multirate::PolyphaseResampler<complex_t>>("PolyphaseResampler/4:5",
+            [=](auto& b, auto in) { b.init(in, 4, 5, resampTaps); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+
+        // 8 taps per phase, small enough for the specialized kernel
+        tap<float> shortResampTaps = taps::alloc<float>(32);
+        fillRandom(shortResampTaps.taps, 32);
+        add<complex_t, complex_t, multirate::PolyphaseResampler<complex_t>>("PolyphaseResampler/4:5/8",
+            [=](auto& b, auto in) { b.init(in, 4, 5, shortResampTaps); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<complex_t, complex_t, GenericPolyphaseResampler<complex_t>>("PolyphaseResampler/4:5/8/generic",
+            [=](auto& b, auto in) { b.init(in, 4, 5, shortResampTaps); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+
+        add<complex_t, float, demod::Quadrature>("Quadrature/fast",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0); },
+            [](auto& b, int count, complex_t* in, float* out) { b.process(count, in, out); });
+        add<complex_t, float, demod::Quadrature>("Quadrature/precise",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0); b.setAccuracy(demod::Quadrature::ACCURACY_PRECISE); },
+            [](auto& b, int count, complex_t* in, float* out) { b.process(count, in, out); });
+
+        // Fused tiles and the previous full buffer passes, per WFM channel
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/stereo",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, true); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.process(count, in, out, rdsCount); });
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/stereo/unfused",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, true); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.processUnfused(count, in, out, rdsCount); });
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/stereo-nolpf",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, true, false); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.process(count, in, out, rdsCount); });
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/stereo-nolpf/unfused",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, true, false); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.processUnfused(count, in, out, rdsCount); });
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/mono",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, false); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.process(count, in, out, rdsCount); });
+        add<complex_t, stereo_t, demod::BroadcastFM>("BroadcastFM/mono/unfused",
+            [](auto& b, auto in) { b.init(in, 75000.0, 250000.0, false); },
+            [](auto& b, int count, complex_t* in, stereo_t* out) { int rdsCount; b.processUnfused(count, in, out, rdsCount); });
+
+        add<complex_t, complex_t, loop::AGC<complex_t>>("AGC<complex>",
+            [](auto& b, auto in) { b.init(in, 1.0, 10e-3, 1e-3, 10e6, 10.0); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<float, float, loop::AGC<float>>("AGC<float>",
+            [](auto& b, auto in) { b.init(in, 1.0, 10e-3, 1e-3, 10e6, 10.0); },
+            [](auto& b, int count, float* in, float* out) { b.process(count, in, out); });
+
+        addChannelizerVFO();
+
+        addSplitter<stream<complex_t>>("stream");
+        addSplitter<ring_stream<complex_t>>("ring");
+
+        addPhasor("sincos", [](float phase) { return math::phasor(phase); });
+        addPhasor("NCO", [](float phase) { return math::NCO::phasor(phase); });
+
+        add<complex_t, complex_t, loop::CarrierTrackingPLL>("CarrierTrackingPLL",
+            [](auto& b, auto in) { b.init(in, 0.01); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+
+        add<complex_t, complex_t, loop::Costas<2>>("Costas<2>",
+            [](auto& b, auto in) { b.init(in, 0.01); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<complex_t, complex_t, loop::Costas<4>>("Costas<4>",
+            [](auto& b, auto in) { b.init(in, 0.01); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+
+        add<complex_t, complex_t, clock_recovery::MM<complex_t>>("MM<complex>",
+            [](auto& b, auto in) { b.init(in, 10.0, 1e-6, 0.01, 0.01); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<float, float, clock_recovery::MM<float>>("MM<float>",
+            [](auto& b, auto in) { b.init(in, 10.0, 1e-6, 0.01, 0.01); },
+            [](auto& b, int count, float* in, float* out) { b.process(count, in, out); });
+        add<complex_t, complex_t, GenericMM<complex_t>>("MM<complex>/generic",
+            [](auto& b, auto in) { b.init(in, 10.0, 1e-6, 0.01, 0.01); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        add<float, float, GenericMM<float>>("MM<float>/generic",
+            [](auto& b, auto in) { b.init(in, 10.0, 1e-6, 0.01, 0.01); },
+            [](auto& b, int count, float* in, float* out) { b.process(count, in, out); });
+
+        // Both FMIF implementations for the bin counts used by the IF noise reduction presets
+        const int fmifBins[] = { 9, 15, 31, 32 };
+        for (int bins : fmifBins) {
+            add<complex_t, complex_t, noise_reduction::FMIF>("FMIF/" + std::to_string(bins),
+                [=](auto& b, auto in) { b.init(in, bins); },
+                [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+            add<complex_t, complex_t, noise_reduction::FFTFMIF>("FFTFMIF/" + std::to_string(bins),
+                [=](auto& b, auto in) { b.init(in, bins); },
+                [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+        }
+
+        add<complex_t, complex_t, noise_reduction::NoiseBlanker>("NoiseBlanker",
+            [](auto& b, auto in) { b.init(in, 500.0 / 24000.0, 10.0); },
+            [](auto& b, int count, complex_t* in, complex_t* out) { b.process(count, in, out); });
+    }
+}
@@ -0,0 +1,99 @@
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define BENCH_DEFAULT_DURATION_MS   1000
+#define BENCH_DEFAULT_BUFFER_SIZE   8192
+
+void printUsage(const char* name) {
+    printf("Usage: %s [options] [filter]\n", name);
+    printf("    --json          Output the results as JSON\n");
+    printf("    --list          List the benchmarks and exit\n");
+    printf("    --duration ms   Duration of each benchmark (default: %d)\n", BENCH_DEFAULT_DURATION_MS);
+    printf("    --buffer size   Samples per buffer (default: %d)\n", BENCH_DEFAULT_BUFFER_SIZE);
+    printf("    --process       Only call process() directly\n");
+    printf("    --threaded      Only run through streams and the block's thread\n");
+    printf("Only the benchmarks whose name contains the filter are run.\n");
+}
+
+std::string jsonEscape(const std::string& str) {
+    std::string out;
+    for (char c : str) {
+        if (c == '"' || c == '\\') { out += '\\'; }
+        out += c;
+    }
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    bool list = false;
+    bool doProcess = true;
+    bool doThreaded = true;
+    int durationMs = BENCH_DEFAULT_DURATION_MS;
+    int bufferSize = BENCH_DEFAULT_BUFFER_SIZE;
+    std::string filter = "";
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") { json = true; }
+        else if (arg == "--list") { list = true; }
+        else if (arg == "--process") { doThreaded = false; }
+        else if (arg == "--threaded") { doProcess = false; }
+        else if (arg == "--duration" && i + 1 < argc) { durationMs = std::stoi(argv[++i]); }
+        else if (arg == "--buffer" && i + 1 < argc) { bufferSize = std::stoi(argv[++i]); }
+        else if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg[0] == '-') { printUsage(argv[0]); return -1; }
+        else { filter = arg; }
+    }
+    if (bufferSize <= 0 || bufferSize > STREAM_BUFFER_SIZE / 8) {
+        fprintf(stderr, "Buffer size must be between 1 and %d\n", STREAM_BUFFER_SIZE / 8);
+        return -1;
+    }
+
+    bench::registerCases();
+
+    if (list) {
+        for (auto& c : bench::cases()) { printf("%s\n", c.name.c_str()); }
+        return 0;
+    }
+
+    // Run benchmarks
+    std::vector<bench::Result> results;
+    if (!json) { printf("%-40s %-9s %12s %12s %8s %10s\n", "block", "mode", "MS/s", "ns/sample", "allocs", "max error"); }
+    for (auto& c : bench::cases()) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) { continue; }
+        std::vector<bench::Result> caseResults;
+        if (doProcess && c.process) { caseResults.push_back(c.process(durationMs, bufferSize)); }
+        if (doThreaded && c.threaded) { caseResults.push_back(c.threaded(durationMs, bufferSize)); }
+        for (auto& r : caseResults) {
+            if (!json) {
+                char err[32] = "-";
+                if (!isnan(r.maxError)) { sprintf(err, "%.3g", r.maxError); }
+                printf("%-40s %-9s %12.3f %12.2f %8llu %10s\n", r.name.c_str(), r.mode.c_str(), r.samplerate / 1e6, r.nsPerSample, (unsigned long long)r.allocations, err);
+            }
+            results.push_back(r);
+        }
+    }
+
+    // Output JSON
+    if (json) {
+        printf("{\n");
+        printf("  \"durationMs\": %d,\n", durationMs);
+        printf("  \"bufferSize\": %d,\n", bufferSize);
+        printf("  \"results\": [\n");
+        for (int i = 0; i < results.size(); i++) {
+            auto& r = results[i];
+            char err[48] = "";
+            if (!isnan(r.maxError)) { sprintf(err, ", \"maxError\": %g", r.maxError); }
+            printf("    { \"name\": \"%s\", \"mode\": \"%s\", \"samplerate\": %.1f, \"nsPerSample\": %.4f, \"allocations\": %llu%s }%s\n",
+                   jsonEscape(r.name).c_str(), r.mode.c_str(), r.samplerate, r.nsPerSample, (unsigned long long)r.allocations, err, (i < results.size() - 1) ? "," : "");
+        }
+        printf("  ]\n");
+        printf("}\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <signal_path/iq_frontend.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/demod/cw.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/filter/deephasis.h>
+#include <dsp/sink/handler_sink.h>
+#include <utils/wav.h>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+namespace offline {
+    enum Mode {
+        MODE_NFM,
+        MODE_WFM,
+        MODE_AM,
+        MODE_DSB,
+        MODE_USB,
+        MODE_LSB,
+        MODE_CW,
+        MODE_RAW
+    };
+
+    // Demodulator parameters, the same as the radio module's defaults
+    struct ModeInfo {
+        const char* name;
+        double ifSamplerate;
+        double bandwidth;
+        double deemphasisTau;
+    };
+
+    inline const ModeInfo& modeInfo(Mode mode) {
+        static const ModeInfo infos[] = {
+            { "nfm", 50000.0, 12500.0, 0.0 },
+            { "wfm", 250000.0, 150000.0, 50e-6 },
+            { "am", 15000.0, 10000.0, 0.0 },
+            { "dsb", 24000.0, 4600.0, 0.0 },
+            { "usb", 24000.0, 2800.0, 0.0 },
+            { "lsb", 24000.0, 2800.0, 0.0 },
+            { "cw", 3000.0, 200.0, 0.0 },
+            { "raw", 48000.0, 48000.0, 0.0 }
+        };
+        return infos[mode];
+    }
+
+    inline bool parseMode(const std::string& str, Mode& mode) {
+        for (int i = MODE_NFM; i <= MODE_RAW; i++) {
+            if (str == modeInfo((Mode)i).name) {
+                mode = (Mode)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // One VFO of the front end, demodulated and written to a file. Raw channels write their IQ as SigMF instead of audio.
+    class Channel {
+    public:
+        Channel(IQFrontEnd* frontEnd, std::string name, Mode mode, double offset, double bandwidth, double frequency, double audioSamplerate) {
+            _frontEnd = frontEnd;
+            _name = name;
+            _mode = mode;
+            const ModeInfo& info = modeInfo(mode);
+            if (bandwidth <= 0.0) { bandwidth = info.bandwidth; }
+
+            // The raw mode keeps the whole bandwidth
+            double ifSamplerate = (mode == MODE_RAW) ? bandwidth : info.ifSamplerate;
+            outSamplerate = (mode == MODE_RAW) ? ifSamplerate : audioSamplerate;
+            vfo = frontEnd->addVFO(name, ifSamplerate, bandwidth, offset);
+            if (!vfo) { throw std::runtime_error("Could not create the VFO"); }
+
+            if (mode == MODE_RAW) {
+                writer.setFormat(wav::FORMAT_RAW);
+                writer.setSampleType(wav::SAMP_TYPE_FLOAT32);
+                writer.setSamplerate(ifSamplerate);
+                rawSink.init(&vfo->out, rawHandler, this);
+            }
+            else {
+                demod.reset(createDemod(mode, bandwidth, ifSamplerate));
+                resamp.init(&demod->out, ifSamplerate, audioSamplerate);
+                dsp::stream<dsp::stereo_t>* audio = &resamp.out;
+                if (info.deemphasisTau > 0.0) {
+                    deemp.init(&resamp.out, info.deemphasisTau, audioSamplerate);
+                    useDeemp = true;
+                    audio = &deemp.out;
+                }
+                audioSink.init(audio, audioHandler, this);
+                writer.setFormat(wav::FORMAT_WAV);
+                writer.setSampleType(wav::SAMP_TYPE_INT16);
+                writer.setSamplerate(audioSamplerate);
+            }
+
+            // Nothing may be lost when processing offline
+            writer.setChannels(2);
+            writer.setBlocking(true);
+            wav::Metadata meta;
+            meta.complex = true;
+            meta.frequency = frequency;
+            meta.description = "SDR++ offline VFO " + name;
+            writer.setMetadata(meta);
+        }
+
+        ~Channel() {
+            stop();
+            _frontEnd->removeVFO(_name);
+        }
+
+        bool open(std::string path) {
+            return writer.open(path + wav::Writer::extension(_mode == MODE_RAW ? wav::FORMAT_RAW : wav::FORMAT_WAV));
+        }
+
+        void start() {
+            if (_mode == MODE_RAW) {
+                rawSink.start();
+                return;
+            }
+            demod->start();
+            resamp.start();
+            if (useDeemp) { deemp.start(); }
+            audioSink.start();
+        }
+
+        void stop() {
+            if (_mode == MODE_RAW) {
+                rawSink.stop();
+            }
+            else {
+                demod->stop();
+                resamp.stop();
+                if (useDeemp) { deemp.stop(); }
+                audioSink.stop();
+            }
+            writer.close();
+        }
+
+        // Samplerate of the file, audio or raw IQ
+        double getOutSamplerate() { return outSamplerate; }
+
+        // Number of samples to write, anything received after that is dropped
+        void setSampleLimit(uint64_t limit) {
+            remaining = limit;
+            done = !limit;
+        }
+
+        // Whether the sample limit was reached
+        bool isDone() { return done; }
+
+        uint64_t getSamplesWritten() { return writer.getSamplesWritten(); }
+
+        std::string getName() { return _name; }
+
+    private:
+        dsp::Processor<dsp::complex_t, dsp::stereo_t>* createDemod(Mode mode, double bandwidth, double samplerate) {
+            const double agcAttack = 50.0 / samplerate;
+            const double agcDecay = 5.0 / samplerate;
+            switch (mode) {
+            case MODE_NFM: {
+                auto d = new dsp::demod::FM<dsp::stereo_t>();
+                d->init(&vfo->out, samplerate, bandwidth, true, false);
+                return d;
+            }
+            case MODE_WFM:
+                return new dsp::demod::BroadcastFM(&vfo->out, bandwidth / 2.0, samplerate, true, true);
+            case MODE_AM:
+                return new dsp::demod::AM<dsp::stereo_t>(&vfo->out, dsp::demod::AM<dsp::stereo_t>::AGCMode::CARRIER, bandwidth, agcAttack, agcDecay, 100.0 / samplerate, samplerate);
+            case MODE_DSB:
+                return new dsp::demod::SSB<dsp::stereo_t>(&vfo->out, dsp::demod::SSB<dsp::stereo_t>::Mode::DSB, bandwidth, samplerate, agcAttack, agcDecay);
+            case MODE_USB:
+                return new dsp::demod::SSB<dsp::stereo_t>(&vfo->out, dsp::demod::SSB<dsp::stereo_t>::Mode::USB, bandwidth, samplerate, agcAttack, agcDecay);
+            case MODE_LSB:
+                return new dsp::demod::SSB<dsp::stereo_t>(&vfo->out, dsp::demod::SSB<dsp::stereo_t>::Mode::LSB, bandwidth, samplerate, agcAttack, agcDecay);
+            case MODE_CW:
+                return new dsp::demod::CW<dsp::stereo_t>(&vfo->out, 800.0, agcAttack, agcDecay, samplerate);
+            default:
+                throw std::runtime_error("Unknown mode");
+            }
+        }
+
+        // Only called from the sink's thread
+        void write(float* data, int count) {
+            int n = std::min<uint64_t>(count, remaining);
+            if (!n) { return; }
+            writer.write(data, n);
+            remaining -= n;
+            if (!remaining) { done = true; }
+        }
+
+        static void audioHandler(dsp::stereo_t* data, int count, void* ctx) {
+            Channel* _this = (Channel*)ctx;
+            _this->write((float*)data, count);
+        }
+
+        static void rawHandler(dsp::complex_t* data, int count, void* ctx) {
+            Channel* _this = (Channel*)ctx;
+            _this->write((float*)data, count);
+        }
+
+        IQFrontEnd* _frontEnd;
+        std::string _name;
+        Mode _mode;
+
+        dsp::channel::RxVFO* vfo;
+        std::unique_ptr<dsp::Processor<dsp::complex_t, dsp::stereo_t>> demod;
+        dsp::multirate::RationalResampler<dsp::stereo_t> resamp;
+        dsp::filter::Deemphasis<dsp::stereo_t> deemp;
+        bool useDeemp = false;
+        dsp::sink::Handler<dsp::stereo_t> audioSink;
+        dsp::sink::Handler<dsp::complex_t> rawSink;
+
+        wav::Writer writer;
+        double outSamplerate;
+        uint64_t remaining = 0;
+        std::atomic<bool> done = true;
+    };
+}
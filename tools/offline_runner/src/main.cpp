@@ -0,0 +1,221 @@
+#include "channel.h"
+#include <utils/iq_reader.h>
+#include <utils/flog.h>
+#include <dsp/scheduler.h>
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <chrono>
+
+#define OFFLINE_DEFAULT_AUDIO_RATE  48000
+#define OFFLINE_BLOCK_SIZE          65536
+// Silence pushed after the input to flush the chain, in seconds of input. Far more than the delay of any chain.
+#define OFFLINE_MAX_FLUSH_S         10
+
+struct VFOSpec {
+    std::string name;
+    double frequency;
+    offline::Mode mode;
+    double bandwidth;
+};
+
+void printUsage(const char* name) {
+    printf("Usage: %s [options] input\n", name);
+    printf("    --vfo name:freq:mode[:bandwidth]  Add a VFO, can be repeated. Modes: nfm, wfm, am, dsb, usb, lsb, cw, raw\n");
+    printf("    --output dir        Output directory (default: current directory)\n");
+    printf("    --frequency hz      Center frequency of the capture (default: from the file, or 0)\n");
+    printf("    --audio-rate hz     Samplerate of the audio files (default: %d)\n", OFFLINE_DEFAULT_AUDIO_RATE);
+    printf("    --decimation n      Power of two decimation applied before the VFOs (default: 1)\n");
+    printf("    --channelizer       Extract all VFOs with the shared channelizer\n");
+    printf("    --threads n         DSP worker threads, 0 for one per core (default: 0)\n");
+    printf("    --no-pool           Run every block on its own thread instead of the worker pool\n");
+    printf("VFO frequencies are absolute when the center frequency is known and offsets otherwise.\n");
+    printf("Audio is written to <output>/<name>.wav, raw VFOs to <output>/<name>.sigmf-data.\n");
+}
+
+bool parseVFO(const std::string& str, VFOSpec& spec) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true) {
+        size_t end = str.find(':', start);
+        parts.push_back(str.substr(start, end - start));
+        if (end == std::string::npos) { break; }
+        start = end + 1;
+    }
+    if (parts.size() < 3 || parts.size() > 4 || parts[0].empty()) { return false; }
+    try {
+        spec.name = parts[0];
+        spec.frequency = std::stod(parts[1]);
+        spec.bandwidth = (parts.size() == 4) ? std::stod(parts[3]) : 0.0;
+    }
+    catch (const std::exception& e) {
+        return false;
+    }
+    return offline::parseMode(parts[2], spec.mode);
+}
+
+float* acquireFFTBuffer(void* ctx) { return NULL; }
+void releaseFFTBuffer(void* ctx) {}
+
+int main(int argc, char* argv[]) {
+    std::vector<VFOSpec> vfoSpecs;
+    std::string outputDir = ".";
+    std::string inputPath = "";
+    double frequency = NAN;
+    double audioRate = OFFLINE_DEFAULT_AUDIO_RATE;
+    int decimation = 1;
+    bool channelizer = false;
+    int threads = 0;
+    bool usePool = true;
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        try {
+            if (arg == "--vfo" && i + 1 < argc) {
+                VFOSpec spec;
+                if (!parseVFO(argv[++i], spec)) {
+                    fprintf(stderr, "Invalid VFO: %s\n", argv[i]);
+                    return -1;
+                }
+                vfoSpecs.push_back(spec);
+            }
+            else if (arg == "--output" && i + 1 < argc) { outputDir = argv[++i]; }
+            else if (arg == "--frequency" && i + 1 < argc) { frequency = std::stod(argv[++i]); }
+            else if (arg == "--audio-rate" && i + 1 < argc) { audioRate = std::stod(argv[++i]); }
+            else if (arg == "--decimation" && i + 1 < argc) { decimation = std::stoi(argv[++i]); }
+            else if (arg == "--channelizer") { channelizer = true; }
+            else if (arg == "--threads" && i + 1 < argc) { threads = std::stoi(argv[++i]); }
+            else if (arg == "--no-pool") { usePool = false; }
+            else if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+            else if (arg[0] == '-' || !inputPath.empty()) { printUsage(argv[0]); return -1; }
+            else { inputPath = arg; }
+        }
+        catch (const std::exception& e) {
+            fprintf(stderr, "Invalid value for %s\n", arg.c_str());
+            return -1;
+        }
+    }
+    if (inputPath.empty() || vfoSpecs.empty()) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (decimation < 1 || (decimation & (decimation - 1))) {
+        fprintf(stderr, "Decimation must be a power of two\n");
+        return -1;
+    }
+    if (audioRate <= 0) {
+        fprintf(stderr, "Audio samplerate must be positive\n");
+        return -1;
+    }
+
+    // Open the input
+    std::unique_ptr<IQReader> reader;
+    try {
+        reader = std::make_unique<IQReader>(inputPath);
+    }
+    catch (const std::exception& e) {
+        flog::error("Could not open '{0}': {1}", inputPath, e.what());
+        return -1;
+    }
+    double samplerate = reader->getSampleRate();
+    if (std::isnan(frequency)) { frequency = reader->getFrequency(); }
+    flog::info("Input: {0} samples at {1} S/s, centered on {2} Hz", reader->getSampleCount(), samplerate, frequency);
+
+    if (!std::filesystem::is_directory(outputDir) && !std::filesystem::create_directories(outputDir)) {
+        flog::error("Could not create the output directory '{0}'", outputDir);
+        return -1;
+    }
+
+    // Blocks pick the worker pool when they start
+    dsp::scheduler::setThreadCount(threads);
+    dsp::scheduler::setEnabled(usePool);
+
+    // Same front end as the receiver, with an FFT slow enough not to matter
+    dsp::stream<dsp::complex_t> input;
+    IQFrontEnd frontEnd;
+    frontEnd.init(&input, samplerate, false, decimation, false, 1024, 1.0, IQFrontEnd::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, NULL);
+    frontEnd.setChannelizer(channelizer);
+
+    // Create the channels
+    double effectiveSr = frontEnd.getEffectiveSamplerate();
+    std::vector<std::unique_ptr<offline::Channel>> channels;
+    for (auto& spec : vfoSpecs) {
+        double offset = frequency ? (spec.frequency - frequency) : spec.frequency;
+        double absFreq = frequency + offset;
+        if (fabs(offset) >= effectiveSr / 2.0) {
+            flog::error("VFO '{0}' is outside of the capture's bandwidth", spec.name);
+            return -1;
+        }
+        try {
+            auto ch = std::make_unique<offline::Channel>(&frontEnd, spec.name, spec.mode, offset, spec.bandwidth, absFreq, audioRate);
+            if (!ch->open(outputDir + "/" + spec.name)) {
+                flog::error("Could not open the output of VFO '{0}'", spec.name);
+                return -1;
+            }
+            channels.push_back(std::move(ch));
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not create VFO '{0}': {1}", spec.name, e.what());
+            return -1;
+        }
+    }
+
+    // Every file gets exactly the duration of the input, whatever the timing of the threads
+    uint64_t count = reader->getSampleCount();
+    for (auto& ch : channels) {
+        ch->setSampleLimit((uint64_t)((double)count * ch->getOutSamplerate() / samplerate));
+    }
+
+    frontEnd.start();
+    for (auto& ch : channels) { ch->start(); }
+
+    // Push the whole file through as fast as the chain takes it
+    auto start = std::chrono::steady_clock::now();
+    auto lastReport = start;
+    int sampleSize = reader->getSampleSize();
+    dsp::convert::IQConverter conv(reader->getFormat());
+    for (uint64_t pos = 0; pos < count;) {
+        int n = std::min<uint64_t>(OFFLINE_BLOCK_SIZE, count - pos);
+        const uint8_t* data = &reader->samples()[pos * sampleSize];
+        if (reader->isFloat()) {
+            memcpy(input.writeBuf, data, n * sizeof(dsp::complex_t));
+        }
+        else {
+            conv.process(n, data, input.writeBuf);
+        }
+        if (!input.swap(n)) { break; }
+        pos += n;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            lastReport = now;
+            fprintf(stderr, "\r%5.1f%%", 100.0 * (double)pos / (double)count);
+        }
+    }
+    fprintf(stderr, "\r");
+
+    // Push silence until every file is complete, this flushes the samples held back by the filters and the partial
+    // blocks of the chain. The input waits for the chain to take each block, so this can't run ahead of it.
+    uint64_t maxFlush = (uint64_t)(samplerate * OFFLINE_MAX_FLUSH_S);
+    for (uint64_t flushed = 0; flushed < maxFlush; flushed += OFFLINE_BLOCK_SIZE) {
+        bool done = true;
+        for (auto& ch : channels) { done &= ch->isDone(); }
+        if (done) { break; }
+        memset(input.writeBuf, 0, OFFLINE_BLOCK_SIZE * sizeof(dsp::complex_t));
+        if (!input.swap(OFFLINE_BLOCK_SIZE)) { break; }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto& ch : channels) {
+        ch->stop();
+        if (!ch->isDone()) { flog::warn("VFO '{0}' did not receive the whole duration of the input", ch->getName()); }
+        flog::info("VFO '{0}': {1} samples written", ch->getName(), ch->getSamplesWritten());
+    }
+    channels.clear();
+    frontEnd.stop();
+
+    double duration = (double)count / samplerate;
+    flog::info("Processed {0} s of IQ in {1} s ({2}x real time)", (int)duration, (int)elapsed, (int)(duration / std::max<double>(elapsed, 1e-6)));
+    return 0;
+}